@@ -6,15 +6,39 @@
 
 #include "flutter/shell/platform/darwin/ios/framework/Source/FlutterDartProject_Internal.h"
 
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "flutter/assets/directory_asset_bundle.h"
+#include "flutter/assets/packed_asset_resolver.h"
+#include "flutter/common/settings_snapshot.h"
 #include "flutter/common/task_runners.h"
+#include "flutter/fml/concurrent_message_loop.h"
+#include "flutter/fml/file.h"
+#include "flutter/fml/logging.h"
 #include "flutter/fml/mapping.h"
 #include "flutter/fml/message_loop.h"
+#include "flutter/fml/task_observer_registry.h"
+#include "flutter/fml/trace_buffer.h"
+#include "flutter/fml/versioned_mapping.h"
 #include "flutter/fml/platform/darwin/scoped_nsobject.h"
 #include "flutter/runtime/dart_vm.h"
+#include "flutter/runtime/isolate_configuration.h"
+#include "flutter/runtime/startup_timeline.h"
+#include "flutter/shell/common/frame_timing_ring.h"
+#include "flutter/shell/common/idle_scheduler.h"
+#include "flutter/shell/common/persistent_cache.h"
+#include "flutter/shell/common/shader_cache_file.h"
 #include "flutter/shell/common/shell.h"
 #include "flutter/shell/common/switches.h"
 #include "flutter/shell/platform/darwin/common/command_line.h"
 #include "flutter/shell/platform/darwin/ios/framework/Headers/FlutterViewController.h"
+#include "third_party/dart/runtime/include/dart_tools_api.h"
 
 extern "C" {
 #if FLUTTER_RUNTIME_MODE == FLUTTER_RUNTIME_MODE_DEBUG
@@ -26,6 +50,165 @@ extern const intptr_t kPlatformStrongDillSize;
 
 static const char* kApplicationKernelSnapshotFileName = "kernel_blob.bin";
 
+static std::shared_ptr<const fml::FileMapping> MapSnapshotData(NSString* name) {
+  NSString* path = [[NSBundle mainBundle] pathForResource:name ofType:@"dat"];
+  if (path.length == 0) {
+    return nullptr;
+  }
+  return fml::FileMapping::CreateReadOnly(path.UTF8String);
+}
+
+static flutter::MappingCallback MakeSnapshotDataCallback(
+    std::shared_ptr<const fml::Mapping> mapping) {
+  // The engine takes ownership of the returned mapping. Keep the underlying file mapping alive
+  // for as long as the engine holds on to it.
+  return [mapping]() {
+    return std::make_unique<fml::NonOwnedMapping>(mapping->GetMapping(),   // bytes
+                                                  mapping->GetSize(),      // byte length
+                                                  [mapping](auto, auto) {}  // release proc
+    );
+  };
+}
+
+// The workers that read kernel pieces. Only started once a project runs from a kernel list, shared
+// by all projects and never torn down.
+static std::shared_ptr<fml::ConcurrentTaskRunner> KernelPieceTaskRunner() {
+  static auto* loop = new std::shared_ptr<fml::ConcurrentMessageLoop>(
+      fml::ConcurrentMessageLoop::Create());
+  return (*loop)->GetTaskRunner();
+}
+
+// Kernel binaries start with this magic number, stored big endian.
+static bool IsKernelBinary(const fml::Mapping& mapping) {
+  static const uint8_t kKernelMagic[] = {0x90, 0xab, 0xcd, 0xef};
+  const uint8_t* data = mapping.GetMapping();
+  return data != nullptr && mapping.GetSize() >= sizeof(kKernelMagic) &&
+         ::memcmp(data, kKernelMagic, sizeof(kKernelMagic)) == 0;
+}
+
+// Returns the asset names listed one per line in a kernel list asset.
+static std::vector<std::string> ParseKernelList(const fml::Mapping& kernel_list) {
+  std::vector<std::string> names;
+  const char* data = reinterpret_cast<const char*>(kernel_list.GetMapping());
+  if (data == nullptr) {
+    return names;
+  }
+  std::istringstream stream(std::string(data, kernel_list.GetSize()));
+  std::string name;
+  while (std::getline(stream, name)) {
+    if (!name.empty() && name.back() == '\r') {
+      name.pop_back();
+    }
+    if (!name.empty()) {
+      names.push_back(name);
+    }
+  }
+  return names;
+}
+
+// Maps and verifies all kernel pieces at the same time. The futures are in list order so that the
+// isolate loads the first piece while the others are still being read. Pieces that are missing or
+// that are not kernel binaries resolve to null, which fails the isolate launch.
+static std::vector<std::future<std::unique_ptr<const fml::Mapping>>> LoadKernelPiecesConcurrently(
+    const std::vector<std::string>& names,
+    const std::shared_ptr<flutter::AssetManager>& asset_manager) {
+  auto task_runner = KernelPieceTaskRunner();
+  std::vector<std::future<std::unique_ptr<const fml::Mapping>>> pieces;
+  pieces.reserve(names.size());
+  for (const auto& name : names) {
+    auto promise = std::make_shared<std::promise<std::unique_ptr<const fml::Mapping>>>();
+    pieces.push_back(promise->get_future());
+    task_runner->PostTask([promise, name, asset_manager]() {
+      std::unique_ptr<const fml::Mapping> piece = asset_manager->GetAsMapping(name);
+      if (!piece) {
+        FML_LOG(ERROR) << "Could not find kernel piece " << name;
+      } else if (!IsKernelBinary(*piece)) {
+        FML_LOG(ERROR) << "Kernel piece " << name << " is not a kernel binary";
+        piece = nullptr;
+      }
+      promise->set_value(std::move(piece));
+    });
+  }
+  return pieces;
+}
+
+// If the bundle ships its assets packed into a single archive, the archive is consulted before the
+// assets directory so that lookups of packed assets never touch the file system.
+static void AddPackedAssetResolver(const flutter::Settings& settings,
+                                   flutter::AssetManager& asset_manager) {
+  if (settings.assets_path.empty()) {
+    return;
+  }
+  std::shared_ptr<const fml::Mapping> archive = fml::FileMapping::CreateReadOnly(
+      settings.assets_path + "/" + flutter::PackedAssetResolver::kArchiveFileName);
+  if (!archive || archive->GetSize() == 0) {
+    return;
+  }
+  auto resolver = flutter::PackedAssetResolver::Create(std::move(archive));
+  if (!resolver) {
+    NSLog(@"Ignoring invalid packed asset archive in %s", settings.assets_path.c_str());
+    return;
+  }
+  asset_manager.PushFront(std::move(resolver));
+}
+
+// Builds the same configuration as |RunConfiguration::InferFromSettings|, but with the packed asset
+// archive in place before the isolate configuration looks up any asset. When running from a kernel
+// list, the pieces are read and verified concurrently instead of one after the other.
+static flutter::RunConfiguration InferRunConfiguration(const flutter::Settings& settings) {
+  auto asset_manager = std::make_shared<flutter::AssetManager>();
+  if (fml::UniqueFD::traits_type::IsValid(settings.assets_dir)) {
+    asset_manager->PushBack(
+        std::make_unique<flutter::DirectoryAssetBundle>(fml::Duplicate(settings.assets_dir)));
+  }
+  asset_manager->PushBack(std::make_unique<flutter::DirectoryAssetBundle>(
+      fml::OpenDirectory(settings.assets_path.c_str(), false, fml::FilePermission::kRead)));
+  AddPackedAssetResolver(settings, *asset_manager);
+
+  // Same precedence as |IsolateConfiguration::InferFromSettings|, which only needs an IO worker for
+  // kernel lists.
+  if (!flutter::DartVM::IsRunningPrecompiledCode() && settings.application_kernel_asset.empty() &&
+      !settings.application_kernel_list_asset.empty()) {
+    auto kernel_list = asset_manager->GetAsMapping(settings.application_kernel_list_asset);
+    if (!kernel_list) {
+      FML_LOG(ERROR) << "Failed to load: " << settings.application_kernel_list_asset;
+      return flutter::RunConfiguration(nullptr, std::move(asset_manager));
+    }
+    auto kernel_pieces = LoadKernelPiecesConcurrently(ParseKernelList(*kernel_list), asset_manager);
+    return flutter::RunConfiguration(
+        flutter::IsolateConfiguration::CreateForKernelList(std::move(kernel_pieces)),
+        std::move(asset_manager));
+  }
+
+  auto isolate_configuration =
+      flutter::IsolateConfiguration::InferFromSettings(settings, asset_manager, nullptr);
+  return flutter::RunConfiguration(std::move(isolate_configuration), std::move(asset_manager));
+}
+
+// An endless trace has no first frame to end it. Instead the events recorded so far are written to
+// the temporary directory whenever the application enters the background, and recording starts over
+// so that each dump holds the events since the previous one.
+static void DumpEndlessTraceBufferInBackground() {
+  static dispatch_once_t once_token;
+  dispatch_once(&once_token, ^{
+    std::string trace_path =
+        std::string(NSTemporaryDirectory().UTF8String) + "/flutter_endless_trace.bin";
+    [[NSNotificationCenter defaultCenter]
+        addObserverForName:UIApplicationDidEnterBackgroundNotification
+                    object:nil
+                     queue:nil
+                usingBlock:^(NSNotification* notification) {
+                  dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                    fml::tracing::TraceBufferStop();
+                    if (!fml::tracing::TraceBufferWriteToFile(trace_path)) {
+                      NSLog(@"Failed to write the endless trace to %s", trace_path.c_str());
+                    }
+                    fml::tracing::TraceBufferStart(true);
+                  });
+                }];
+  });
+}
+
 static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
   auto command_line = flutter::CommandLineFromNSProcessInfo();
 
@@ -48,22 +231,68 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
 
   auto settings = flutter::SettingsFromCommandLine(command_line);
 
+  // Startup and endless traces are recorded into the binary trace buffer, which costs far less per
+  // event than the timeline. Convert dumps with trace_buffer_to_json.py.
+  if (settings.trace_startup || settings.endless_trace_buffer) {
+    fml::tracing::TraceBufferStart(settings.endless_trace_buffer);
+  }
+  if (settings.endless_trace_buffer) {
+    DumpEndlessTraceBufferInBackground();
+  }
+
+  // Observers are kept in the thread's registry so that the message loop makes a single observer
+  // call per task. Observers that do not fit in the registry go to the message loop directly. A key
+  // is only ever registered in one of the two places, so it is never notified twice.
   settings.task_observer_add = [](intptr_t key, fml::closure callback) {
+    auto& registry = fml::TaskObserverRegistry::ForCurrentThread();
+    if (registry.Add(key, callback)) {
+      fml::MessageLoop::GetCurrent().RemoveTaskObserver(key);
+      return;
+    }
+    registry.Remove(key);
     fml::MessageLoop::GetCurrent().AddTaskObserver(key, std::move(callback));
   };
 
   settings.task_observer_remove = [](intptr_t key) {
+    fml::TaskObserverRegistry::ForCurrentThread().Remove(key);
     fml::MessageLoop::GetCurrent().RemoveTaskObserver(key);
   };
 
+  // Observers that only care about idleness are notified when the framework goes idle.
+  auto idle_notification_callback = settings.idle_notification_callback;
+  settings.idle_notification_callback = [idle_notification_callback](int64_t deadline) {
+    fml::TaskObserverRegistry::ForCurrentThread().Flush();
+    if (idle_notification_callback) {
+      idle_notification_callback(deadline);
+    }
+  };
+
   // The command line arguments may not always be complete. If they aren't, attempt to fill in
   // defaults.
 
-  // Flutter ships the ICU data file in the the bundle of the engine. Look for it there.
-  if (settings.icu_data_path.size() == 0) {
-    NSString* icuDataPath = [engineBundle pathForResource:@"icudtl" ofType:@"dat"];
+  // Flutter ships the ICU data file in the the bundle of the engine. Applications may instead ship
+  // one stripped down to the locales they use (see strip_icu_data.py) and point to it from their
+  // Info.plist.
+  if (settings.icu_data_path.size() == 0 && !settings.icu_mapper) {
+    NSString* icuDataPath = nil;
+    NSString* icuDataName = [mainBundle objectForInfoDictionaryKey:@"FLTICUDataPath"];
+    if (icuDataName.length > 0) {
+      icuDataPath = [mainBundle pathForResource:icuDataName ofType:@""];
+    }
+    if (icuDataPath.length == 0) {
+      icuDataPath = [engineBundle pathForResource:@"icudtl" ofType:@"dat"];
+    }
     if (icuDataPath.length > 0) {
-      settings.icu_data_path = icuDataPath.UTF8String;
+      // ICU only ever touches the packages of the locales in use. Map the file without read-ahead
+      // so that the rest of it is never faulted in.
+      std::string icu_data_path = icuDataPath.UTF8String;
+      settings.icu_mapper = [icu_data_path]() -> std::unique_ptr<fml::Mapping> {
+        auto mapping = fml::FileMapping::CreateReadOnly(icu_data_path);
+        if (mapping) {
+          mapping->AdviseRandomAccess();
+        }
+        return mapping;
+      };
     }
   }
 
@@ -138,22 +367,47 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
   }
 
   //数据段分离 从外部设置路径
-  NSString *isolatePath = [[NSBundle mainBundle] pathForResource:@"_kDartIsolateSnapshotData" ofType:@"dat"];
-  if (isolatePath) {
-    NSData *data = [[NSData dataWithContentsOfFile:isolatePath] retain];
-    if (data) {
-      const uint8_t* mapData = (const uint8_t *)[data bytes];
-      settings.isolate_snapshot_data_ptr = mapData;
-    }
+  // The split snapshot data is mapped instead of being copied into an NSData so that its pages
+  // stay clean and can be dropped from the resident set once the VM has deserialized them.
+  auto isolate_data = MapSnapshotData(@"_kDartIsolateSnapshotData");
+  if (isolate_data) {
+    settings.isolate_snapshot_data = MakeSnapshotDataCallback(isolate_data);
   }
 
-  NSString *vmPath = [[NSBundle mainBundle] pathForResource:@"_kDartVmSnapshotData" ofType:@"dat"];
-  if (vmPath) {
-    NSData *data = [[NSData dataWithContentsOfFile:vmPath] retain];
-    if (data) {
-      const uint8_t* mapData = (const uint8_t *)[data bytes];
-      settings.vm_snapshot_data_ptr = mapData;
-    }
+  auto vm_data = MapSnapshotData(@"_kDartVmSnapshotData");
+  if (vm_data) {
+    settings.vm_snapshot_data = MakeSnapshotDataCallback(vm_data);
+  }
+
+  if (vm_data || isolate_data) {
+    // The VM data is only read during VM initialization and the isolate data while the isolate
+    // group is created. Both have happened by the time the first root isolate is created. Later
+    // isolates fault the pages they need back in from the file, so the pages are only released
+    // once per process. The resident bytes given back are recorded in the startup timeline.
+    auto root_isolate_create_callback = settings.root_isolate_create_callback;
+    settings.root_isolate_create_callback = [vm_data, isolate_data,
+                                             root_isolate_create_callback]() {
+      static std::atomic<bool> released(false);
+      if (!released.exchange(true)) {
+        auto start = fml::TimePoint::Now();
+        size_t released_bytes = 0;
+        for (const auto& mapping : {vm_data, isolate_data}) {
+          if (!mapping) {
+            continue;
+          }
+          size_t resident = mapping->GetResidentSize();
+          if (mapping->ReleaseResidentPages()) {
+            size_t remaining = mapping->GetResidentSize();
+            released_bytes += resident > remaining ? resident - remaining : 0;
+          }
+        }
+        flutter::StartupTimeline::GetInstance().Record("ReleaseSnapshotDataPages", start,
+                                                       fml::TimePoint::Now(), released_bytes);
+      }
+      if (root_isolate_create_callback) {
+        root_isolate_create_callback();
+      }
+    };
   }
 
 #if FLUTTER_RUNTIME_MODE == FLUTTER_RUNTIME_MODE_DEBUG
@@ -170,8 +424,43 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
   return settings;
 }
 
+// The defaults only depend on the bundle and the command line of the process. They are resolved
+// once per bundle and shared by all projects created from it, which layer their own callbacks on
+// top.
+static flutter::SettingsSnapshot DefaultSettingsSnapshotForProcess(NSBundle* bundle) {
+  static std::mutex mutex;
+  static auto* snapshots = new std::unordered_map<std::string, flutter::SettingsSnapshot>();
+  std::string key = bundle ? bundle.bundlePath.UTF8String : "";
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = snapshots->find(key);
+  if (found != snapshots->end()) {
+    return found->second;
+  }
+  auto start = fml::TimePoint::Now();
+  flutter::SettingsSnapshot snapshot(DefaultSettingsForProcess(bundle));
+  flutter::StartupTimeline::GetInstance().Record("FlutterDartProject::DefaultSettingsForProcess",
+                                                 start, fml::TimePoint::Now());
+  snapshots->emplace(std::move(key), snapshot);
+  return snapshot;
+}
+
 @implementation FlutterDartProject {
-  flutter::Settings _settings;
+  // The defaults shared with the other projects of the bundle. The callbacks of this project are
+  // layered on top of them and only applied, with a single copy, once an engine asks for the
+  // settings.
+  flutter::SettingsSnapshot _defaultSettings;
+  std::vector<flutter::SettingsSnapshot::Override> _settingsLayers;
+  std::shared_ptr<const fml::Mapping> _persistentIsolateDataMapping;
+  // Null until resolved, and resolved again once stale.
+  std::unique_ptr<flutter::SettingsSnapshot> _settings;
+  // The settings before the last resolve. References handed out by -settings may still point into
+  // them, so they are kept until the next resolve rather than dropped with the change.
+  std::unique_ptr<flutter::SettingsSnapshot> _previousSettings;
+  BOOL _settingsStale;
+  std::shared_ptr<fml::VersionedMapping> _persistentIsolateData;
+  std::shared_ptr<flutter::FrameTimingRing> _frameTimings;
+  std::shared_ptr<flutter::IdleScheduler> _idleScheduler;
 }
 
 #pragma mark - Override base class designated initializers
@@ -186,16 +475,199 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
   self = [super init];
 
   if (self) {
-    _settings = DefaultSettingsForProcess(bundle);
+    _defaultSettings = DefaultSettingsSnapshotForProcess(bundle);
+
+    // Frames are aggregated on the raster thread so that frame statistics can be pulled
+    // periodically instead of crossing into platform code for every frame.
+    _frameTimings = std::make_shared<flutter::FrameTimingRing>();
+    _settingsLayers.push_back([frame_timings = _frameTimings](flutter::Settings& settings) {
+      auto frame_rasterized_callback = std::move(settings.frame_rasterized_callback);
+      settings.frame_rasterized_callback = [frame_timings,
+                                            frame_rasterized_callback](const auto& timing) {
+        frame_timings->Record(timing);
+        if (frame_rasterized_callback) {
+          frame_rasterized_callback(timing);
+        }
+      };
+    });
+
+    // Idle deadlines are in the time base of the Dart timeline. Work that has waited too long for
+    // an idle period large enough runs in a regular task on the same thread instead, so that it
+    // never overruns an idle deadline.
+    auto weak_idle_scheduler = std::make_shared<std::weak_ptr<flutter::IdleScheduler>>();
+    _idleScheduler = std::make_shared<flutter::IdleScheduler>(
+        [] { return Dart_TimelineGetMicros(); },
+        [weak_idle_scheduler] {
+          fml::MessageLoop::GetCurrent().GetTaskRunner()->PostTask(
+              [idle_scheduler = *weak_idle_scheduler] {
+                if (auto scheduler = idle_scheduler.lock()) {
+                  scheduler->RunOverdue();
+                }
+              });
+        });
+    *weak_idle_scheduler = _idleScheduler;
+    _settingsLayers.push_back([idle_scheduler = _idleScheduler](flutter::Settings& settings) {
+      auto idle_notification_callback = std::move(settings.idle_notification_callback);
+      settings.idle_notification_callback = [idle_scheduler,
+                                             idle_notification_callback](int64_t deadline) {
+        if (idle_notification_callback) {
+          idle_notification_callback(deadline);
+        }
+        idle_scheduler->RunUntil(deadline);
+      };
+    });
+
+    if (_defaultSettings->cache_sksl) {
+      [self setUpShaderCache];
+    }
+
+    [self recordStartupMilestones];
   }
 
   return self;
 }
 
+// Compiled shaders persist across launches in a single file shared by all projects of the process.
+// The programs used by the first frames of the previous launch are warmed on a background queue.
+// Each project counts its own frames, and the cache is saved once they complete the hot set and
+// again whenever later frames stored new programs.
+- (void)setUpShaderCache {
+  auto shader_cache = flutter::ShaderCacheFile::GetForProcess();
+  if (!shader_cache) {
+    std::string directory = _defaultSettings->temp_directory_path.empty()
+                                ? std::string(NSTemporaryDirectory().UTF8String)
+                                : _defaultSettings->temp_directory_path;
+    shader_cache = std::make_shared<flutter::ShaderCacheFile>(
+        std::move(directory), flutter::PersistentCache::GetCacheForProcess());
+    flutter::ShaderCacheFile::SetForProcess(shader_cache);
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+      shader_cache->PrecompileHotEntries();
+    });
+  }
+
+  bool report_stats = _defaultSettings->trace_startup;
+  auto frame_count = std::make_shared<std::atomic<size_t>>(0);
+  _settingsLayers.push_back([shader_cache, report_stats, frame_count](flutter::Settings& settings) {
+    auto frame_rasterized_callback = std::move(settings.frame_rasterized_callback);
+    settings.frame_rasterized_callback = [shader_cache, report_stats, frame_count,
+                                          frame_rasterized_callback](const auto& timing) {
+      auto raster_time = timing.Get(flutter::FrameTiming::kRasterFinish) -
+                         timing.Get(flutter::FrameTiming::kRasterStart);
+      if (shader_cache->DidRasterizeFrame(++*frame_count, raster_time)) {
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+          if (!shader_cache->Save()) {
+            NSLog(@"Failed to save the shader cache");
+          }
+          if (report_stats) {
+            auto stats = shader_cache->GetStats();
+            NSLog(@"Shader cache: %zu hits, %zu misses (%.1f%%), %zu hot, %zu warmed, first "
+                  @"frame rasterized in %.2f ms",
+                  stats.hits, stats.misses, stats.hit_rate * 100.0, stats.hot_entries,
+                  stats.precompiled_entries, stats.first_frame_raster_time.ToMillisecondsF());
+          }
+        });
+      }
+      if (frame_rasterized_callback) {
+        frame_rasterized_callback(timing);
+      }
+    };
+  });
+}
+
+// Adds the creation of the root isolate and the first frame of each shell to the startup timeline.
+// With trace_startup, the timeline and the startup trace buffer are written to the temporary
+// directory once the first frame of the process has been rasterized. Later projects only add their
+// milestones to the timeline.
+- (void)recordStartupMilestones {
+  std::string report_directory;
+  if (_defaultSettings->trace_startup) {
+    report_directory = NSTemporaryDirectory().UTF8String;
+  }
+  bool endless_trace_buffer = _defaultSettings->endless_trace_buffer;
+  auto first_frame_recorded = std::make_shared<std::atomic<bool>>(false);
+  _settingsLayers.push_back([first_frame_recorded, report_directory,
+                             endless_trace_buffer](flutter::Settings& settings) {
+    auto root_isolate_create_callback = std::move(settings.root_isolate_create_callback);
+    settings.root_isolate_create_callback = [root_isolate_create_callback]() {
+      flutter::StartupTimeline::GetInstance().Mark("RootIsolateCreated");
+      if (root_isolate_create_callback) {
+        root_isolate_create_callback();
+      }
+    };
+
+    auto frame_rasterized_callback = std::move(settings.frame_rasterized_callback);
+    settings.frame_rasterized_callback = [first_frame_recorded, report_directory,
+                                          endless_trace_buffer,
+                                          frame_rasterized_callback](const auto& timing) {
+      if (!first_frame_recorded->exchange(true)) {
+        flutter::StartupTimeline::GetInstance().Record(
+            "FirstFrame", timing.Get(flutter::FrameTiming::kBuildStart),
+            timing.Get(flutter::FrameTiming::kRasterFinish));
+        static std::atomic<bool> report_written(false);
+        if (!report_directory.empty() && !report_written.exchange(true)) {
+          if (!endless_trace_buffer) {
+            fml::tracing::TraceBufferStop();
+          }
+          // Serializing and writing the report takes milliseconds, which the raster thread cannot
+          // spare.
+          dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            std::string report_path = report_directory + "/flutter_startup_timeline.json";
+            std::string trace_path = report_directory + "/flutter_startup_trace.bin";
+            bool written = flutter::StartupTimeline::GetInstance().WriteReport(report_path) &&
+                           fml::tracing::TraceBufferWriteToFile(trace_path);
+            if (!written) {
+              NSLog(@"Failed to write the startup timeline to %s", report_directory.c_str());
+            }
+          });
+        }
+      }
+      if (frame_rasterized_callback) {
+        frame_rasterized_callback(timing);
+      }
+    };
+  });
+}
+
 #pragma mark - Settings accessors
 
+// Applies the layers of this project to the shared defaults. This is the only place where the
+// settings of a project are copied.
+- (const flutter::SettingsSnapshot&)resolvedSettings {
+  if (!_settings || _settingsStale) {
+    auto start = fml::TimePoint::Now();
+    auto layers = _settingsLayers;
+    // Shells read the version that is current when they are created, and keep it for their
+    // lifetime.
+    std::shared_ptr<const fml::Mapping> persistent_isolate_data =
+        _persistentIsolateData ? _persistentIsolateData->Acquire() : _persistentIsolateDataMapping;
+    if (persistent_isolate_data) {
+      layers.push_back([mapping = std::move(persistent_isolate_data)](flutter::Settings& settings) {
+        settings.persistent_isolate_data = mapping;
+      });
+    }
+    _previousSettings = std::move(_settings);
+    _settings = std::make_unique<flutter::SettingsSnapshot>(_defaultSettings.With(layers));
+    _settingsStale = NO;
+    flutter::StartupTimeline::GetInstance().Record("FlutterDartProject::ResolveSettings", start,
+                                                   fml::TimePoint::Now());
+  }
+  return *_settings;
+}
+
 - (const flutter::Settings&)settings {
-  return _settings;
+  return [self resolvedSettings].Get();
+}
+
+- (flutter::SettingsSnapshot)settingsSnapshot {
+  return [self resolvedSettings];
+}
+
+- (std::shared_ptr<flutter::FrameTimingRing>)frameTimings {
+  return _frameTimings;
+}
+
+- (std::shared_ptr<flutter::IdleScheduler>)idleScheduler {
+  return _idleScheduler;
 }
 
 - (flutter::RunConfiguration)runConfiguration {
@@ -208,7 +680,7 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
 
 - (flutter::RunConfiguration)runConfigurationForEntrypoint:(nullable NSString*)entrypointOrNil
                                               libraryOrNil:(nullable NSString*)dartLibraryOrNil {
-  auto config = flutter::RunConfiguration::InferFromSettings(_settings);
+  auto config = InferRunConfiguration(_defaultSettings);
   if (dartLibraryOrNil && entrypointOrNil) {
     config.SetEntrypointAndLibrary(std::string([entrypointOrNil UTF8String]),
                                    std::string([dartLibraryOrNil UTF8String]));
@@ -270,11 +742,38 @@ static flutter::Settings DefaultSettingsForProcess(NSBundle* bundle = nil) {
   fml::NonOwnedMapping::ReleaseProc data_release_proc = [persistent_isolate_data](auto, auto) {
     [persistent_isolate_data release];
   };
-  _settings.persistent_isolate_data = std::make_shared<fml::NonOwnedMapping>(
+  _persistentIsolateDataMapping = std::make_shared<fml::NonOwnedMapping>(
       static_cast<const uint8_t*>(persistent_isolate_data.bytes),  // bytes
       persistent_isolate_data.length,                              // byte length
       data_release_proc                                            // release proc
   );
+  _persistentIsolateData.reset();
+  _settingsStale = YES;
+}
+
+- (BOOL)setPersistentIsolateDataWithContentsOfFile:(NSString*)path version:(uint64_t)version {
+  if (path.length == 0) {
+    return NO;
+  }
+
+  std::shared_ptr<const fml::Mapping> mapping = fml::FileMapping::CreateReadOnly(path.UTF8String);
+  if (!mapping) {
+    NSLog(@"Failed to map persistent isolate data at \"%@\"", path);
+    return NO;
+  }
+
+  // Shells that are already running keep the version they were created with. The superseded
+  // version is unmapped once the last of them is gone.
+  if (_persistentIsolateData) {
+    if (!_persistentIsolateData->Update(std::move(mapping), version)) {
+      return NO;
+    }
+  } else {
+    _persistentIsolateData = std::make_shared<fml::VersionedMapping>(std::move(mapping), version);
+  }
+  _persistentIsolateDataMapping.reset();
+  _settingsStale = YES;
+  return YES;
 }
 
 @end
@@ -0,0 +1,79 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SHELL_PLATFORM_IOS_FRAMEWORK_SOURCE_FLUTTERDARTPROJECT_INTERNAL_H_
+#define SHELL_PLATFORM_IOS_FRAMEWORK_SOURCE_FLUTTERDARTPROJECT_INTERNAL_H_
+
+#include "flutter/common/settings.h"
+#include "flutter/common/settings_snapshot.h"
+#include "flutter/runtime/platform_data.h"
+#include "flutter/shell/common/engine.h"
+#include "flutter/shell/common/frame_timing_ring.h"
+#include "flutter/shell/common/idle_scheduler.h"
+#include "flutter/shell/platform/darwin/ios/framework/Headers/FlutterDartProject.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface FlutterDartProject ()
+
+/**
+ * The settings of this project. The reference survives one change of the settings, and is only
+ * invalidated when they are resolved after a second change. Hold on to a -settingsSnapshot to keep
+ * the settings for longer.
+ */
+- (const flutter::Settings&)settings;
+
+/**
+ * The settings of this project as a snapshot that shells and engines can hold on to without copying
+ * them. Later changes to the project's settings do not affect snapshots handed out earlier.
+ */
+- (flutter::SettingsSnapshot)settingsSnapshot;
+
+/**
+ * The timings of the frames rasterized by shells created from this project. Frame statistics can
+ * be pulled from it at any time and from any thread.
+ */
+- (std::shared_ptr<flutter::FrameTimingRing>)frameTimings;
+
+/**
+ * Runs deferrable work registered by engine subsystems and plugins in the idle time between frames
+ * of shells created from this project.
+ */
+- (std::shared_ptr<flutter::IdleScheduler>)idleScheduler;
+
+- (flutter::RunConfiguration)runConfiguration;
+- (flutter::RunConfiguration)runConfigurationForEntrypoint:(nullable NSString*)entrypointOrNil;
+- (flutter::RunConfiguration)runConfigurationForEntrypoint:(nullable NSString*)entrypointOrNil
+                                              libraryOrNil:(nullable NSString*)dartLibraryOrNil;
+
++ (NSString*)flutterAssetsName:(NSBundle*)bundle;
+
+/**
+ * The embedder can specify data that the isolate can request synchronously on launch. This
+ * accessor is typically used by the plugin registrar.
+ *
+ * @param data The data that is guaranteed to be available to the isolate on launch. The data is
+ *             copied, so it must be as small as possible.
+ */
+- (void)setPersistentIsolateData:(NSData*)data;
+
+/**
+ * Makes the contents of a file available to the isolate on launch without copying them. Calling
+ * this again with a newer version replaces the data for shells created from this project
+ * afterwards. Shells that are already running keep the version they were created with, and the
+ * file of a superseded version stays mapped until the last of them shuts down.
+ *
+ * @param path    The path of the file. It is mapped read-only and must not be modified in place.
+ *                Write new versions to a new file instead.
+ * @param version The version of the data. Must be greater than the version of any data
+ *                previously set through this method.
+ * @return YES if the data was set.
+ */
+- (BOOL)setPersistentIsolateDataWithContentsOfFile:(NSString*)path version:(uint64_t)version;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif  // SHELL_PLATFORM_IOS_FRAMEWORK_SOURCE_FLUTTERDARTPROJECT_INTERNAL_H_
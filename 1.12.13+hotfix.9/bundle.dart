@@ -3,17 +3,22 @@
 // found in the LICENSE file.
 
 import 'dart:async';
+import 'dart:convert';
+import 'dart:typed_data';
 
+import 'package:crypto/crypto.dart';
 import 'package:meta/meta.dart';
 import 'package:pool/pool.dart';
 
 import 'asset.dart';
 import 'base/common.dart';
 import 'base/file_system.dart';
+import 'base/io.dart';
 import 'base/logger.dart';
 import 'build_info.dart';
 import 'build_system/build_system.dart';
 import 'build_system/depfile.dart';
+import 'build_system/targets/assets.dart';
 import 'build_system/targets/dart.dart';
 import 'dart/package_map.dart';
 import 'devfs.dart';
@@ -67,6 +72,8 @@ class BundleBuilder {
     List<String> extraGenSnapshotOptions = const <String>[],
     List<String> fileSystemRoots,
     String fileSystemScheme,
+    bool packAssets = false,
+    Set<String> looseAssets = const <String>{},
   }) async {
     mainPath ??= defaultMainPath;
     depfilePath ??= defaultDepfilePath;
@@ -86,6 +93,8 @@ class BundleBuilder {
       depfilePath: depfilePath,
       precompiled: precompiledSnapshot,
       trackWidgetCreation: trackWidgetCreation,
+      packAssets: packAssets,
+      looseAssets: looseAssets,
     );
     // Work around for flutter_tester placing kernel artifacts in odd places.
     if (applicationKernelFilePath != null) {
@@ -110,6 +119,8 @@ Future<void> buildWithAssemble({
   @required String depfilePath,
   @required bool precompiled,
   bool trackWidgetCreation,
+  bool packAssets = false,
+  Set<String> looseAssets = const <String>{},
 }) async {
   // If the precompiled flag was not passed, force us into debug mode.
   buildMode = precompiled ? buildMode : BuildMode.debug;
@@ -122,11 +133,18 @@ Future<void> buildWithAssemble({
       kBuildMode: getNameForBuildMode(buildMode),
       kTargetPlatform: getNameForTargetPlatform(targetPlatform),
       kTrackWidgetCreation: trackWidgetCreation?.toString(),
+      if (packAssets) kLooseAssets: looseAssets.join(','),
     },
   );
-  final Target target = buildMode == BuildMode.debug
+  final Target bundleTarget = buildMode == BuildMode.debug
     ? const CopyFlutterBundle()
     : const ReleaseCopyFlutterBundle();
+  final Target target = packAssets ? PackFlutterAssets(bundleTarget) : bundleTarget;
+  final File staleArchive = fs.directory(outputDir).childFile(kPackedAssetArchiveName);
+  if (!packAssets && staleArchive.existsSync()) {
+    // A stale archive would shadow the loose assets at runtime.
+    staleArchive.deleteSync();
+  }
   final BuildResult result = await buildSystem.build(target, environment);
 
   if (!result.success) {
@@ -175,13 +193,29 @@ Future<AssetBundle> buildAssets({
   return assetBundle;
 }
 
+/// Writes [assetEntries] into [bundleDir].
+///
+/// The content hash, size and modification time of every asset is recorded in
+/// the build directory of the project, so that a later call only writes the
+/// assets whose contents changed, or whose files were touched since, and
+/// deletes the ones that went away. A bundle without that record is rebuilt
+/// from scratch.
+///
+/// If [packAssets] is set, the assets are written into a packed asset archive
+/// instead, except for those in [looseAssets], see [PackFlutterAssets].
 Future<void> writeBundle(
   Directory bundleDir,
   Map<String, DevFSContent> assetEntries,
-  { Logger loggerOverride }
+  {
+    Logger loggerOverride,
+    bool packAssets = false,
+    Set<String> looseAssets = const <String>{},
+  }
 ) async {
   loggerOverride ??= logger;
-  if (bundleDir.existsSync()) {
+  final File recordFile = _assetRecordFile(bundleDir);
+  final Map<String, _AssetRecord> previousRecords = _readAssetRecords(recordFile);
+  if (previousRecords.isEmpty && bundleDir.existsSync()) {
     try {
       bundleDir.deleteSync(recursive: true);
     } on FileSystemException catch (err) {
@@ -192,6 +226,16 @@ Future<void> writeBundle(
     }
   }
   bundleDir.createSync(recursive: true);
+  // Older tools kept the record in the bundle, which shipped it with the app.
+  final File legacyRecordFile = bundleDir.childFile('.asset_hashes.json');
+  if (legacyRecordFile.existsSync()) {
+    legacyRecordFile.deleteSync();
+  }
+
+  final Map<String, String> hashes = <String, String>{};
+  final Map<String, _AssetRecord> records = <String, _AssetRecord>{};
+  final Map<String, List<int>> packedContents = <String, List<int>>{};
+  int unchanged = 0;
 
   // Limit number of open files to avoid running out of file descriptors.
   final Pool pool = Pool(64);
@@ -199,11 +243,469 @@ Future<void> writeBundle(
     assetEntries.entries.map<Future<void>>((MapEntry<String, DevFSContent> entry) async {
       final PoolResource resource = await pool.request();
       try {
+        final List<int> contents = await entry.value.contentsAsBytes();
+        final String hash = md5.convert(contents).toString();
         final File file = fs.file(bundleDir.uri.resolve(entry.key));
+        hashes[entry.key] = hash;
+        if (packAssets && _isPackedAsset(entry.key, looseAssets)) {
+          packedContents[entry.key] = contents;
+          records[entry.key] = _AssetRecord(hash);
+          // Only shipped in the archive.
+          if (file.existsSync()) {
+            file.deleteSync();
+          }
+          unchanged += 1;
+          return;
+        }
+        final _AssetRecord previous = previousRecords[entry.key];
+        if (previous != null && previous.matches(hash, file)) {
+          records[entry.key] = previous;
+          unchanged += 1;
+          return;
+        }
         file.parent.createSync(recursive: true);
-        await file.writeAsBytes(await entry.value.contentsAsBytes());
+        await file.writeAsBytes(contents);
+        records[entry.key] = _AssetRecord.ofFile(hash, file);
       } finally {
         resource.release();
       }
     }));
+
+  // Loose files of assets that were removed.
+  for (String name in previousRecords.keys) {
+    if (hashes.containsKey(name) || name == kPackedAssetArchiveName) {
+      continue;
+    }
+    final File file = fs.file(bundleDir.uri.resolve(name));
+    if (file.existsSync()) {
+      file.deleteSync();
+    }
+  }
+
+  final File archive = bundleDir.childFile(kPackedAssetArchiveName);
+  if (packAssets) {
+    final String archiveHash = _packedAssetsHash(packedContents.keys, hashes);
+    final _AssetRecord previous = previousRecords[kPackedAssetArchiveName];
+    if (previous != null && previous.matches(archiveHash, archive)) {
+      records[kPackedAssetArchiveName] = previous;
+    } else {
+      writePackedAssetArchive(archive, packedContents);
+      records[kPackedAssetArchiveName] = _AssetRecord.ofFile(archiveHash, archive);
+    }
+  } else if (archive.existsSync()) {
+    // A stale archive would shadow the loose assets at runtime.
+    archive.deleteSync();
+  }
+
+  _writeAssetRecords(recordFile, records);
+  loggerOverride.printTrace('Wrote ${assetEntries.length - unchanged} of ${assetEntries.length} assets, '
+    'the others were unchanged or packed.');
+}
+
+// What [writeBundle] last wrote for an asset of a bundle directory.
+//
+// Packed assets have no loose file, so only their hash is recorded.
+class _AssetRecord {
+  _AssetRecord(this.hash, [this.size, this.modified]);
+
+  _AssetRecord.ofFile(this.hash, File file)
+    : size = file.lengthSync(),
+      modified = file.lastModifiedSync().millisecondsSinceEpoch;
+
+  static _AssetRecord fromJson(dynamic value) {
+    if (value is! Map<String, dynamic>) {
+      return null;
+    }
+    final Map<String, dynamic> map = value as Map<String, dynamic>;
+    if (map['hash'] is! String) {
+      return null;
+    }
+    return _AssetRecord(map['hash'] as String, map['size'] as int, map['modified'] as int);
+  }
+
+  final String hash;
+  final int size;
+  final int modified;
+
+  // Whether [file] still holds the contents with [hash] that were written,
+  // judged by its size and modification time rather than by reading it.
+  bool matches(String hash, File file) {
+    return this.hash == hash &&
+      size != null &&
+      file.existsSync() &&
+      file.lengthSync() == size &&
+      file.lastModifiedSync().millisecondsSinceEpoch == modified;
+  }
+
+  Map<String, dynamic> toJson() => <String, dynamic>{
+    'hash': hash,
+    if (size != null) 'size': size,
+    if (modified != null) 'modified': modified,
+  };
+}
+
+// The record of [bundleDir], kept with the other build state of the project
+// rather than in the bundle, so that it does not ship with the app.
+File _assetRecordFile(Directory bundleDir) {
+  final String key = md5.convert(utf8.encode(bundleDir.absolute.path)).toString();
+  return FlutterProject.current().dartTool
+    .childDirectory('flutter_build')
+    .childDirectory('asset_records')
+    .childFile('$key.json');
+}
+
+Map<String, _AssetRecord> _readAssetRecords(File file) {
+  if (!file.existsSync()) {
+    return <String, _AssetRecord>{};
+  }
+  dynamic decoded;
+  try {
+    decoded = json.decode(file.readAsStringSync());
+  } on FormatException {
+    return <String, _AssetRecord>{};
+  }
+  final Map<String, _AssetRecord> records = <String, _AssetRecord>{};
+  if (decoded is Map<String, dynamic>) {
+    for (MapEntry<String, dynamic> entry in decoded.entries) {
+      final _AssetRecord record = _AssetRecord.fromJson(entry.value);
+      if (record != null) {
+        records[entry.key] = record;
+      }
+    }
+  }
+  return records;
+}
+
+void _writeAssetRecords(File file, Map<String, _AssetRecord> records) {
+  file.parent.createSync(recursive: true);
+  file.writeAsStringSync(json.encode(records));
+}
+
+// A hash over the names and content hashes of the assets in an archive, which
+// changes whenever the archive would.
+String _packedAssetsHash(Iterable<String> names, Map<String, String> hashes) {
+  final List<String> sortedNames = names.toList()..sort();
+  final StringBuffer buffer = StringBuffer('$_kPackedAssetVersion\n');
+  for (String name in sortedNames) {
+    buffer.writeln('$name ${hashes[name]}');
+  }
+  return md5.convert(utf8.encode(buffer.toString())).toString();
+}
+
+/// The name of the archive that holds the packed assets of a bundle.
+///
+/// The engine serves assets out of this archive before it looks in the asset
+/// directory, see `flutter/assets/packed_asset_resolver.h` for the layout.
+const String kPackedAssetArchiveName = 'assets.pack';
+
+/// The define that lists, separated by commas, the assets that
+/// [PackFlutterAssets] keeps loose instead of packing them.
+const String kLooseAssets = 'LooseAssets';
+
+// Files of the asset directory that the engine reads by path rather than
+// through the asset manager, so they must stay loose.
+const Set<String> _kUnpackedFiles = <String>{
+  'kernel_blob.bin',
+  'vm_snapshot_data',
+  'isolate_snapshot_data',
+  kPackedAssetArchiveName,
+};
+
+bool _isPackedAsset(String name, Set<String> looseAssets) {
+  return !_kUnpackedFiles.contains(name) && !looseAssets.contains(name);
+}
+
+const int _kPackedAssetVersion = 2;
+const int _kPackedAssetHeaderSize = 32;
+const int _kPackedAssetEntrySize = 40;
+const int _kPackedAssetAlignment = 8;
+const int _kPackedAssetPageSize = 4096;
+
+// The codecs of `PackedAssetResolver::Codec`.
+const int _kPackedAssetStored = 0;
+const int _kPackedAssetZlib = 1;
+
+// Assets smaller than this are not worth a trip through the inflater.
+const int _kMinCompressedAssetSize = 512;
+
+// Compressed assets must come out at most this fraction of their size,
+// otherwise they are stored and served without a copy.
+const double _kMaxCompressionRatio = 0.875;
+
+// Formats that are compressed already and do not shrink any further.
+const Set<String> _kStoredExtensions = <String>{
+  '.png', '.jpg', '.jpeg', '.gif', '.webp', '.heic',
+  '.mp3', '.mp4', '.m4a', '.aac', '.ogg', '.webm',
+  '.zip', '.gz', '.woff', '.woff2',
+};
+
+/// Packs the assets that [bundle] copies into the output directory into a
+/// packed asset archive next to them, and removes the packed assets from the
+/// output directory so that every asset ships only once.
+///
+/// Platform code that resolves assets by their path in the bundle, such as
+/// `lookupKeyForAsset` on iOS, cannot see into the archive. The assets it
+/// needs must be listed in the [kLooseAssets] define. They are left out of the
+/// archive and stay loose, and the engine still finds them in the asset
+/// directory.
+class PackFlutterAssets extends Target {
+  const PackFlutterAssets(this.bundle);
+
+  /// The target that copies the assets, either [CopyFlutterBundle] or
+  /// [ReleaseCopyFlutterBundle].
+  final Target bundle;
+
+  @override
+  String get name => 'pack_flutter_assets';
+
+  @override
+  List<Target> get dependencies => <Target>[bundle];
+
+  @override
+  List<Source> get inputs => const <Source>[
+    Source.pattern('{FLUTTER_ROOT}/packages/flutter_tools/lib/src/bundle.dart'),
+    Source.pattern('{OUTPUT_DIR}/AssetManifest.json'),
+    Source.pattern('{OUTPUT_DIR}/FontManifest.json'),
+    Source.pattern('{OUTPUT_DIR}/LICENSE'),
+    Source.behavior(AssetOutputBehavior('flutter_assets')),
+  ];
+
+  @override
+  List<Source> get outputs => const <Source>[
+    Source.pattern('{OUTPUT_DIR}/$kPackedAssetArchiveName'),
+  ];
+
+  @override
+  Future<void> build(Environment environment) async {
+    final String looseAssets = environment.defines[kLooseAssets] ?? '';
+    await packAssetDirectory(
+      environment.outputDir,
+      cacheDir: environment.buildDir.childDirectory('packed_assets'),
+      looseAssets: looseAssets.split(',').where((String name) => name.isNotEmpty).toSet(),
+    );
+  }
+}
+
+/// Writes the assets in [assetDir] into a packed asset archive in the same
+/// directory and deletes the packed assets. The assets in [looseAssets] are
+/// not packed and stay in place.
+///
+/// If [cacheDir] is given, every asset is encoded for the archive only once
+/// per content hash. The encoded assets are kept in [cacheDir], so repacking
+/// after a change only compresses the assets that changed. Entries of assets
+/// that are no longer packed are removed.
+Future<void> packAssetDirectory(
+  Directory assetDir, {
+  Directory cacheDir,
+  Set<String> looseAssets = const <String>{},
+}) async {
+  final List<_PackedAsset> entries = <_PackedAsset>[];
+  final List<File> packedFiles = <File>[];
+  final Set<String> usedCacheEntries = <String>{};
+  int encoded = 0;
+  for (FileSystemEntity entity in assetDir.listSync(recursive: true)) {
+    if (entity is! File) {
+      continue;
+    }
+    final String name = fs.path.relative(entity.path, from: assetDir.path)
+      .replaceAll(fs.path.separator, '/');
+    if (!_isPackedAsset(name, looseAssets)) {
+      continue;
+    }
+    packedFiles.add(entity as File);
+    final List<int> contents = await (entity as File).readAsBytes();
+    if (cacheDir == null) {
+      entries.add(_PackedAsset.encode(name, contents));
+      encoded += 1;
+      continue;
+    }
+    // Compression depends on the extension as well as the contents.
+    final String key = md5.convert(<int>[
+      ...utf8.encode('$_kPackedAssetVersion ${fs.path.extension(name).toLowerCase()}\n'),
+      ...contents,
+    ]).toString();
+    usedCacheEntries.add(key);
+    final File cached = cacheDir.childFile(key);
+    _PackedAsset entry = cached.existsSync()
+      ? _PackedAsset.decodeCached(name, contents, await cached.readAsBytes())
+      : null;
+    if (entry == null) {
+      entry = _PackedAsset.encode(name, contents);
+      encoded += 1;
+      cached.parent.createSync(recursive: true);
+      await cached.writeAsBytes(entry.toCached());
+    }
+    entries.add(entry);
+  }
+
+  if (cacheDir != null && cacheDir.existsSync()) {
+    for (FileSystemEntity entity in cacheDir.listSync()) {
+      if (entity is File && !usedCacheEntries.contains(entity.basename)) {
+        entity.deleteSync();
+      }
+    }
+  }
+
+  _writePackedAssetEntries(assetDir.childFile(kPackedAssetArchiveName), entries);
+  for (File file in packedFiles) {
+    file.deleteSync();
+  }
+  printTrace('Packed ${entries.length} assets into $kPackedAssetArchiveName, '
+    'of which $encoded had to be encoded.');
+}
+
+/// Writes [assets], keyed by asset name, into a packed asset archive.
+void writePackedAssetArchive(File archive, Map<String, List<int>> assets) {
+  _writePackedAssetEntries(archive, assets.entries
+    .map<_PackedAsset>((MapEntry<String, List<int>> entry) => _PackedAsset.encode(entry.key, entry.value))
+    .toList());
+}
+
+void _writePackedAssetEntries(File archive, List<_PackedAsset> entries) {
+  entries.sort(_PackedAsset.compare);
+
+  final List<int> names = <int>[];
+  for (_PackedAsset entry in entries) {
+    entry.nameOffset = names.length;
+    names.addAll(entry.name);
+  }
+  const int indexOffset = _kPackedAssetHeaderSize;
+  final int namesOffset = indexOffset + entries.length * _kPackedAssetEntrySize;
+  int dataOffset = namesOffset + names.length;
+  for (_PackedAsset entry in entries) {
+    // Large stored assets start on their own page so that their pages can be
+    // faulted in and dropped independently of their neighbours.
+    final int alignment = entry.codec == _kPackedAssetStored && entry.data.length >= _kPackedAssetPageSize
+      ? _kPackedAssetPageSize
+      : _kPackedAssetAlignment;
+    dataOffset = _alignTo(dataOffset, alignment);
+    entry.dataOffset = dataOffset;
+    dataOffset += entry.data.length;
+  }
+
+  final ByteData header = ByteData(namesOffset)
+    ..setUint8(0, 0x46) // 'F'
+    ..setUint8(1, 0x4C) // 'L'
+    ..setUint8(2, 0x54) // 'T'
+    ..setUint8(3, 0x41) // 'A'
+    ..setUint32(4, _kPackedAssetVersion, Endian.little)
+    ..setUint32(8, entries.length, Endian.little)
+    ..setUint64(16, indexOffset, Endian.little)
+    ..setUint64(24, namesOffset, Endian.little);
+  for (int i = 0; i < entries.length; i++) {
+    final _PackedAsset entry = entries[i];
+    final int offset = indexOffset + i * _kPackedAssetEntrySize;
+    header
+      ..setUint64(offset, entry.hash, Endian.little)
+      ..setUint32(offset + 8, entry.nameOffset, Endian.little)
+      ..setUint16(offset + 12, entry.name.length, Endian.little)
+      ..setUint8(offset + 14, entry.codec)
+      ..setUint64(offset + 16, entry.dataOffset, Endian.little)
+      ..setUint64(offset + 24, entry.data.length, Endian.little)
+      ..setUint64(offset + 32, entry.size, Endian.little);
+  }
+
+  archive.parent.createSync(recursive: true);
+  final RandomAccessFile output = archive.openSync(mode: FileMode.write);
+  try {
+    output
+      ..writeFromSync(header.buffer.asUint8List())
+      ..writeFromSync(names);
+    int position = namesOffset + names.length;
+    for (_PackedAsset entry in entries) {
+      if (entry.dataOffset > position) {
+        output.writeFromSync(Uint8List(entry.dataOffset - position));
+      }
+      output.writeFromSync(entry.data);
+      position = entry.dataOffset + entry.data.length;
+    }
+  } finally {
+    output.closeSync();
+  }
+}
+
+int _alignTo(int value, int alignment) {
+  return (value + alignment - 1) ~/ alignment * alignment;
+}
+
+class _PackedAsset {
+  _PackedAsset(this.name, this.codec, this.data, this.size) : hash = hashName(name);
+
+  /// Packs [contents], compressing it if that pays off for its size and type.
+  factory _PackedAsset.encode(String name, List<int> contents) {
+    final List<int> encodedName = utf8.encode(name);
+    if (encodedName.length > 0xFFFF) {
+      throwToolExit('Asset name too long to pack: $name');
+    }
+    if (contents.length >= _kMinCompressedAssetSize &&
+        !_kStoredExtensions.contains(fs.path.extension(name).toLowerCase())) {
+      final List<int> compressed = ZLibEncoder(level: 9).convert(contents);
+      if (compressed.length <= contents.length * _kMaxCompressionRatio) {
+        return _PackedAsset(encodedName, _kPackedAssetZlib, compressed, contents.length);
+      }
+    }
+    return _PackedAsset(encodedName, _kPackedAssetStored, contents, contents.length);
+  }
+
+  /// Restores an asset encoded earlier from the bytes [toCached] returned for
+  /// it, or returns null if they are not usable.
+  factory _PackedAsset.decodeCached(String name, List<int> contents, List<int> cached) {
+    if (cached.isEmpty) {
+      return null;
+    }
+    final List<int> encodedName = utf8.encode(name);
+    if (cached[0] == _kPackedAssetStored && cached.length == 1) {
+      return _PackedAsset(encodedName, _kPackedAssetStored, contents, contents.length);
+    }
+    if (cached[0] == _kPackedAssetZlib && cached.length > 1) {
+      return _PackedAsset(encodedName, _kPackedAssetZlib, cached.sublist(1), contents.length);
+    }
+    return null;
+  }
+
+  /// The codec followed by the compressed bytes. Stored assets only record
+  /// the codec, their bytes are the asset itself.
+  List<int> toCached() {
+    return <int>[codec, if (codec != _kPackedAssetStored) ...data];
+  }
+
+  final List<int> name;
+  final int codec;
+  /// The bytes written to the archive, compressed according to [codec].
+  final List<int> data;
+  /// The size of the asset once decoded.
+  final int size;
+  final int hash;
+  int nameOffset;
+  int dataOffset;
+
+  /// The 64-bit FNV-1a hash of [name], matching `PackedAssetResolver::HashName`.
+  ///
+  /// Dart integers wrap at 64 bits, so the hash may come out negative; it is
+  /// written as the same unsigned bit pattern the engine computes.
+  static int hashName(List<int> name) {
+    int hash = -0x340d631b7bdddcdb; // 0xcbf29ce484222325
+    for (int byte in name) {
+      hash ^= byte;
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  /// Orders by unsigned hash, which is the order the engine binary searches.
+  static int compare(_PackedAsset a, _PackedAsset b) {
+    if (a.hash != b.hash) {
+      if ((a.hash < 0) != (b.hash < 0)) {
+        return a.hash < 0 ? 1 : -1;
+      }
+      return a.hash.compareTo(b.hash);
+    }
+    final int length = a.name.length < b.name.length ? a.name.length : b.name.length;
+    for (int i = 0; i < length; i++) {
+      if (a.name[i] != b.name[i]) {
+        return a.name[i].compareTo(b.name[i]);
+      }
+    }
+    return a.name.length.compareTo(b.name.length);
+  }
 }
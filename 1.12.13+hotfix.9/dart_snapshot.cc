@@ -4,13 +4,24 @@
 
 #include "flutter/runtime/dart_snapshot.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
 #include <sstream>
 
 #include "flutter/fml/native_library.h"
 #include "flutter/fml/paths.h"
+#include "flutter/fml/trace_buffer.h"
 #include "flutter/fml/trace_event.h"
+#if OS_LINUX
+#include "flutter/fml/shared_memory_mapping.h"
+#endif  // OS_LINUX
 #include "flutter/lib/snapshot/snapshot.h"
 #include "flutter/runtime/dart_vm.h"
+#include "flutter/runtime/startup_timeline.h"
 
 namespace flutter {
 
@@ -38,6 +49,124 @@ static std::unique_ptr<const fml::Mapping> GetFileMapping(
   }
 }
 
+// Opening a native library is expensive on slow storage, and the snapshot
+// lookups are repeated for every isolate launched. Instead of probing the
+// application libraries for each of the snapshot symbols in turn, each library
+// is opened at most once and all the snapshot symbols are resolved from it in
+// the same pass. The result of every symbol, including a failure to find it, is
+// kept per set of application libraries for later lookups. A library named for
+// a symbol in |Settings::application_library_symbol_paths| is probed first for
+// that symbol, so an accurate manifest avoids failed probes altogether.
+// Libraries are only kept open by the symbols found in them.
+static std::shared_ptr<const fml::Mapping> ResolveLibrarySymbol(
+    const Settings& settings,
+    const char* native_library_symbol_name) {
+  FML_TRACE_BUFFER_SCOPE("DartSnapshot::ResolveLibrarySymbol");
+
+  const char* symbol_names[] = {
+      DartSnapshot::kVMDataSymbol,
+      DartSnapshot::kVMInstructionsSymbol,
+      DartSnapshot::kIsolateDataSymbol,
+      DartSnapshot::kIsolateInstructionsSymbol,
+  };
+  constexpr size_t kSymbolCount = sizeof(symbol_names) / sizeof(const char*);
+
+  // Libraries in the order in which they are probed.
+  std::vector<std::string> library_paths;
+  auto add_library_path = [&library_paths](const std::string& path) {
+    if (std::find(library_paths.begin(), library_paths.end(), path) ==
+        library_paths.end()) {
+      library_paths.push_back(path);
+    }
+  };
+  const auto& manifest = settings.application_library_symbol_paths;
+  for (const char* symbol_name : symbol_names) {
+    auto manifest_path = manifest.find(symbol_name);
+    if (manifest_path != manifest.end()) {
+      add_library_path(manifest_path->second);
+    }
+  }
+  for (const std::string& path : settings.application_library_path) {
+    add_library_path(path);
+  }
+
+  std::string cache_key;
+  for (const std::string& path : library_paths) {
+    cache_key.append(path);
+    cache_key.push_back('\0');
+  }
+
+  using ResolvedSymbols =
+      std::map<std::string, std::shared_ptr<const fml::Mapping>>;
+  static std::mutex resolved_mutex;
+  static auto* resolved_libraries = new std::map<std::string, ResolvedSymbols>();
+
+  std::lock_guard<std::mutex> lock(resolved_mutex);
+  ResolvedSymbols& resolved_symbols = (*resolved_libraries)[cache_key];
+  auto resolved = resolved_symbols.find(native_library_symbol_name);
+  if (resolved != resolved_symbols.end()) {
+    return resolved->second;
+  }
+
+  // Opens each library at most once during this pass.
+  std::map<std::string, fml::RefPtr<fml::NativeLibrary>> libraries;
+  auto open_library = [&libraries](const std::string& path) {
+    auto library = libraries.find(path);
+    if (library == libraries.end()) {
+      library = libraries
+                    .emplace(path, fml::NativeLibrary::Create(path.c_str()))
+                    .first;
+    }
+    return library->second;
+  };
+
+  ResolvedSymbols found;
+  auto resolve_symbol = [&found](const fml::RefPtr<fml::NativeLibrary>& library,
+                                 const char* symbol_name) {
+    if (!library || found.count(symbol_name) > 0) {
+      return;
+    }
+    auto symbol_mapping =
+        std::make_shared<const fml::SymbolMapping>(library, symbol_name);
+    if (symbol_mapping->GetMapping() != nullptr) {
+      found[symbol_name] = std::move(symbol_mapping);
+    }
+  };
+
+  // Look in the library the manifest names for each symbol.
+  for (const char* symbol_name : symbol_names) {
+    auto manifest_path = manifest.find(symbol_name);
+    if (manifest_path != manifest.end()) {
+      resolve_symbol(open_library(manifest_path->second), symbol_name);
+    }
+  }
+
+  // Look in application specified native libraries if specified.
+  for (const std::string& path : library_paths) {
+    if (found.size() == kSymbolCount) {
+      break;
+    }
+    auto library = open_library(path);
+    for (const char* symbol_name : symbol_names) {
+      resolve_symbol(library, symbol_name);
+    }
+  }
+
+  // Look inside the currently loaded process.
+  if (found.size() < kSymbolCount) {
+    auto loaded_process = fml::NativeLibrary::CreateForCurrentProcess();
+    for (const char* symbol_name : symbol_names) {
+      resolve_symbol(loaded_process, symbol_name);
+    }
+  }
+
+  // Symbols that were not found are recorded as misses.
+  for (const char* symbol_name : symbol_names) {
+    resolved_symbols[symbol_name] = found[symbol_name];
+  }
+  return resolved_symbols[native_library_symbol_name];
+}
+
 // The first party embedders don't yet use the stable embedder API and depend on
 // the engine figuring out the locations of the various heap and instructions
 // buffers. Consequently, the engine had baked in opinions about where these
@@ -50,55 +179,135 @@ static std::unique_ptr<const fml::Mapping> GetFileMapping(
 // moves to the embedder API, this method can effectively be reduced to just
 // invoking the embedder_mapping_callback directly.
 static std::shared_ptr<const fml::Mapping> SearchMapping(
+    const Settings& settings,
     MappingCallback embedder_mapping_callback,
     const std::string& file_path,
-    const std::vector<std::string>& native_library_path,
     const char* native_library_symbol_name,
-    bool is_executable) {
+    bool is_executable,
+    StartupTimeline::Source* source) {
   // Ask the embedder. There is no fallback as we expect the embedders (via
   // their embedding APIs) to just specify the mappings directly.
   if (embedder_mapping_callback) {
+    *source = StartupTimeline::Source::kCallback;
     return embedder_mapping_callback();
   }
 
   // Attempt to open file at path specified.
   if (file_path.size() > 0) {
     if (auto file_mapping = GetFileMapping(file_path, is_executable)) {
+      *source = StartupTimeline::Source::kFile;
       return file_mapping;
     }
   }
 
-  // Look in application specified native library if specified.
-  for (const std::string& path : native_library_path) {
-    auto native_library = fml::NativeLibrary::Create(path.c_str());
-    auto symbol_mapping = std::make_unique<const fml::SymbolMapping>(
-        native_library, native_library_symbol_name);
-    if (symbol_mapping->GetMapping() != nullptr) {
-      return symbol_mapping;
+  // Look in the application specified native libraries and the currently
+  // loaded process.
+  *source = StartupTimeline::Source::kSymbol;
+  return ResolveLibrarySymbol(settings, native_library_symbol_name);
+}
+
+#if OS_LINUX
+// Identifies the data that a shared memory object is published from without
+// reading it. Changes whenever the file, or the application library holding the
+// symbol, is replaced. Returns zero for data supplied by the embedder, whose
+// origin is unknown and which is therefore never shared.
+static uint64_t SnapshotSourceId(
+    const Settings& settings,
+    const MappingCallback& embedder_mapping_callback,
+    const std::string& file_path,
+    const char* native_library_symbol_name) {
+  if (embedder_mapping_callback) {
+    return 0;
+  }
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  auto add = [&hash](const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ull;
+    }
+  };
+  auto add_file = [&add](const std::string& path) {
+    struct stat info = {};
+    if (::stat(path.c_str(), &info) != 0) {
+      return false;
     }
+    const int64_t identity[] = {
+        static_cast<int64_t>(info.st_dev),  static_cast<int64_t>(info.st_ino),
+        static_cast<int64_t>(info.st_size), static_cast<int64_t>(info.st_mtime),
+        static_cast<int64_t>(info.st_mtim.tv_nsec),
+    };
+    add(path.data(), path.size());
+    add(identity, sizeof(identity));
+    return true;
+  };
+
+  add(native_library_symbol_name, ::strlen(native_library_symbol_name));
+  if (!file_path.empty() && add_file(file_path)) {
+    return hash;
+  }
+  bool identified = false;
+  for (const auto& path : settings.application_library_path) {
+    identified = add_file(path) || identified;
   }
+  return identified ? hash : 0;
+}
+#endif  // OS_LINUX
 
-  // Look inside the currently loaded process.
-  {
-    auto loaded_process = fml::NativeLibrary::CreateForCurrentProcess();
-    auto symbol_mapping = std::make_unique<const fml::SymbolMapping>(
-        loaded_process, native_library_symbol_name);
-    if (symbol_mapping->GetMapping() != nullptr) {
-      return symbol_mapping;
+// Snapshot data is never executable. Unlike instructions, which must be mapped
+// from the application library, it may be shared between engine processes.
+static std::shared_ptr<const fml::Mapping> SearchDataMapping(
+    const Settings& settings,
+    MappingCallback embedder_mapping_callback,
+    const std::string& file_path,
+    const char* native_library_symbol_name,
+    StartupTimeline::Source* source) {
+  std::shared_ptr<const fml::Mapping> private_mapping;
+  auto search_private_mapping = [&]() {
+    if (!private_mapping) {
+      private_mapping = SearchMapping(settings,                    //
+                                      embedder_mapping_callback,   //
+                                      file_path,                   //
+                                      native_library_symbol_name,  //
+                                      false,                       //
+                                      source                       //
+      );
+    }
+    return private_mapping;
+  };
+
+#if OS_LINUX
+  const uint64_t source_id =
+      settings.snapshot_shared_memory_name.empty()
+          ? 0
+          : SnapshotSourceId(settings, embedder_mapping_callback, file_path,
+                             native_library_symbol_name);
+  if (source_id != 0) {
+    auto shared_mapping = fml::SharedMemoryMapping::CreateOrOpen(
+        settings.snapshot_shared_memory_name + "." + native_library_symbol_name,
+        source_id, search_private_mapping);
+    if (shared_mapping) {
+      *source = StartupTimeline::Source::kSharedMemory;
+      return shared_mapping;
     }
   }
+#endif  // OS_LINUX
 
-  return nullptr;
+  return search_private_mapping();
 }
 
 #endif  // !DART_SNAPSHOT_STATIC_LINK
 
 static std::shared_ptr<const fml::Mapping> ResolveVMData(
-    const Settings& settings) {
+    const Settings& settings,
+    StartupTimeline::Source* source) {
 #if DART_SNAPSHOT_STATIC_LINK
+  *source = StartupTimeline::Source::kSymbol;
   return std::make_unique<fml::NonOwnedMapping>(kDartVmSnapshotData, 0);
 #else   // DART_SNAPSHOT_STATIC_LINK
   if (settings.vm_snapshot_data_ptr != NULL){
+    *source = StartupTimeline::Source::kExternalPointer;
     auto symbol_mapping = std::make_unique<const fml::SymbolMapping>(
         settings.vm_snapshot_data_ptr);
     return symbol_mapping;
@@ -110,38 +319,44 @@ static std::shared_ptr<const fml::Mapping> ResolveVMData(
     //   false                               // is_executable
     // );
   } else {
-    return SearchMapping(
+    return SearchDataMapping(
+      settings,                           // settings
       settings.vm_snapshot_data,          // embedder_mapping_callback
       settings.vm_snapshot_data_path,     // file_path
-      settings.application_library_path,  // native_library_path
       DartSnapshot::kVMDataSymbol,        // native_library_symbol_name
-      false                               // is_executable
+      source                              // source
     );
   }
 #endif  // DART_SNAPSHOT_STATIC_LINK
 }
 
 static std::shared_ptr<const fml::Mapping> ResolveVMInstructions(
-    const Settings& settings) {
+    const Settings& settings,
+    StartupTimeline::Source* source) {
 #if DART_SNAPSHOT_STATIC_LINK
+  *source = StartupTimeline::Source::kSymbol;
   return std::make_unique<fml::NonOwnedMapping>(kDartVmSnapshotInstructions, 0);
 #else   // DART_SNAPSHOT_STATIC_LINK
   return SearchMapping(
+      settings,                             // settings
       settings.vm_snapshot_instr,           // embedder_mapping_callback
       settings.vm_snapshot_instr_path,      // file_path
-      settings.application_library_path,    // native_library_path
       DartSnapshot::kVMInstructionsSymbol,  // native_library_symbol_name
-      true                                  // is_executable
+      true,                                 // is_executable
+      source                                // source
   );
 #endif  // DART_SNAPSHOT_STATIC_LINK
 }
 
 static std::shared_ptr<const fml::Mapping> ResolveIsolateData(
-    const Settings& settings) {
+    const Settings& settings,
+    StartupTimeline::Source* source) {
 #if DART_SNAPSHOT_STATIC_LINK
+  *source = StartupTimeline::Source::kSymbol;
   return std::make_unique<fml::NonOwnedMapping>(kDartIsolateSnapshotData, 0);
 #else   // DART_SNAPSHOT_STATIC_LINK
   if (settings.isolate_snapshot_data_ptr != NULL) {
+    *source = StartupTimeline::Source::kExternalPointer;
     auto symbol_mapping = std::make_unique<const fml::SymbolMapping>(
           settings.isolate_snapshot_data_ptr);
     return symbol_mapping;
@@ -153,40 +368,61 @@ static std::shared_ptr<const fml::Mapping> ResolveIsolateData(
     //   false                                 // is_executable
     // );
   } else {
-    return SearchMapping(
+    return SearchDataMapping(
+      settings,                             // settings
       settings.isolate_snapshot_data,       // embedder_mapping_callback
       settings.isolate_snapshot_data_path,  // file_path
-      settings.application_library_path,    // native_library_path
       DartSnapshot::kIsolateDataSymbol,     // native_library_symbol_name
-      false                                 // is_executable
+      source                                // source
     );
   }
 #endif  // DART_SNAPSHOT_STATIC_LINK
 }
 
 static std::shared_ptr<const fml::Mapping> ResolveIsolateInstructions(
-    const Settings& settings) {
+    const Settings& settings,
+    StartupTimeline::Source* source) {
 #if DART_SNAPSHOT_STATIC_LINK
+  *source = StartupTimeline::Source::kSymbol;
   return std::make_unique<fml::NonOwnedMapping>(
       kDartIsolateSnapshotInstructions, 0);
 #else   // DART_SNAPSHOT_STATIC_LINK
   return SearchMapping(
+      settings,                                  // settings
       settings.isolate_snapshot_instr,           // embedder_mapping_callback
       settings.isolate_snapshot_instr_path,      // file_path
-      settings.application_library_path,         // native_library_path
       DartSnapshot::kIsolateInstructionsSymbol,  // native_library_symbol_name
-      true                                       // is_executable
+      true,                                      // is_executable
+      source                                     // source
   );
 #endif  // DART_SNAPSHOT_STATIC_LINK
 }
 
+// Resolves a piece of a snapshot and records the time it took, its size and
+// where it came from in the startup timeline.
+static std::shared_ptr<const fml::Mapping> ResolveAndRecord(
+    const char* name,
+    std::shared_ptr<const fml::Mapping> (*resolve)(const Settings&,
+                                                   StartupTimeline::Source*),
+    const Settings& settings) {
+  auto source = StartupTimeline::Source::kNone;
+  auto start = fml::TimePoint::Now();
+  auto mapping = resolve(settings, &source);
+  StartupTimeline::GetInstance().Record(name, start, fml::TimePoint::Now(),
+                                        mapping ? mapping->GetSize() : 0,
+                                        source);
+  return mapping;
+}
+
 fml::RefPtr<DartSnapshot> DartSnapshot::VMSnapshotFromSettings(
     const Settings& settings) {
   TRACE_EVENT0("flutter", "DartSnapshot::VMSnapshotFromSettings");
-  auto snapshot =
-      fml::MakeRefCounted<DartSnapshot>(ResolveVMData(settings),         //
-                                        ResolveVMInstructions(settings)  //
-      );
+  FML_TRACE_BUFFER_SCOPE("DartSnapshot::VMSnapshotFromSettings");
+  auto snapshot = fml::MakeRefCounted<DartSnapshot>(
+      ResolveAndRecord("ResolveVMData", ResolveVMData, settings),  //
+      ResolveAndRecord("ResolveVMInstructions", ResolveVMInstructions,
+                       settings)  //
+  );
   if (snapshot->IsValid()) {
     return snapshot;
   }
@@ -196,10 +432,12 @@ fml::RefPtr<DartSnapshot> DartSnapshot::VMSnapshotFromSettings(
 fml::RefPtr<DartSnapshot> DartSnapshot::IsolateSnapshotFromSettings(
     const Settings& settings) {
   TRACE_EVENT0("flutter", "DartSnapshot::IsolateSnapshotFromSettings");
-  auto snapshot =
-      fml::MakeRefCounted<DartSnapshot>(ResolveIsolateData(settings),         //
-                                        ResolveIsolateInstructions(settings)  //
-      );
+  FML_TRACE_BUFFER_SCOPE("DartSnapshot::IsolateSnapshotFromSettings");
+  auto snapshot = fml::MakeRefCounted<DartSnapshot>(
+      ResolveAndRecord("ResolveIsolateData", ResolveIsolateData, settings),  //
+      ResolveAndRecord("ResolveIsolateInstructions",
+                       ResolveIsolateInstructions, settings)  //
+  );
   if (snapshot->IsValid()) {
     return snapshot;
   }
@@ -0,0 +1,171 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/frame_timing_ring.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+constexpr size_t FrameTimingRing::kCapacity;
+
+FrameTimingRing::FrameTimingRing() = default;
+
+FrameTimingRing::~FrameTimingRing() = default;
+
+static int64_t DurationMicros(const FrameTiming& timing,
+                              FrameTiming::Phase start,
+                              FrameTiming::Phase finish) {
+  int64_t micros = (timing.Get(finish) - timing.Get(start)).ToMicroseconds();
+  return std::max<int64_t>(micros, 0);
+}
+
+static fml::TimePoint LoadTimePoint(const std::atomic<int64_t>& nanos) {
+  return fml::TimePoint::FromEpochDelta(
+      fml::TimeDelta::FromNanoseconds(nanos.load(std::memory_order_relaxed)));
+}
+
+void FrameTimingRing::Record(const FrameTiming& timing) {
+  build_.Add(DurationMicros(timing, FrameTiming::kBuildStart,
+                            FrameTiming::kBuildFinish));
+  raster_.Add(DurationMicros(timing, FrameTiming::kRasterStart,
+                             FrameTiming::kRasterFinish));
+
+  const uint64_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index % kCapacity];
+
+  // Seqlock write: readers that observe an odd or changed sequence discard
+  // what they read. The slot is only taken over from a writer that is done
+  // with an older frame. Otherwise another writer is still busy with it, or
+  // already wrote a newer frame, and this frame is dropped from the ring as it
+  // would have been overwritten anyway.
+  uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  do {
+    if (sequence % 2 != 0 || sequence > 2 * index) {
+      return;
+    }
+  } while (!slot.sequence.compare_exchange_weak(sequence, 2 * index + 1,
+                                                std::memory_order_relaxed));
+  std::atomic_thread_fence(std::memory_order_release);
+  for (auto phase : FrameTiming::kPhases) {
+    slot.phases[phase].store(timing.Get(phase).ToEpochDelta().ToNanoseconds(),
+                             std::memory_order_relaxed);
+  }
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+  // Writers may finish out of order. Readers skip the slots of the frames
+  // that are still being written.
+  uint64_t frame_count = frame_count_.load(std::memory_order_relaxed);
+  while (frame_count < index + 1 &&
+         !frame_count_.compare_exchange_weak(frame_count, index + 1,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t FrameTimingRing::GetFrameCount() const {
+  return frame_count_.load(std::memory_order_acquire);
+}
+
+std::vector<FrameTiming> FrameTimingRing::GetRecentFrames(
+    size_t max_count) const {
+  const uint64_t end = frame_count_.load(std::memory_order_acquire);
+  const uint64_t count = std::min<uint64_t>({end, max_count, kCapacity});
+
+  std::vector<FrameTiming> frames;
+  frames.reserve(count);
+  for (uint64_t index = end - count; index < end; index++) {
+    const Slot& slot = slots_[index % kCapacity];
+    const uint64_t expected = 2 * index + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected) {
+      continue;
+    }
+    FrameTiming timing;
+    for (auto phase : FrameTiming::kPhases) {
+      timing.Set(phase, LoadTimePoint(slot.phases[phase]));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+      continue;
+    }
+    frames.push_back(timing);
+  }
+  return frames;
+}
+
+FrameTimingStats FrameTimingRing::CollectStats() {
+  FrameTimingStats stats;
+  stats.build = build_.Collect(&stats.frame_count);
+  stats.raster = raster_.Collect(nullptr);
+  return stats;
+}
+
+int FrameTimingRing::Histogram::BucketForValue(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<int>(value);
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  int shift = exponent - kSubBucketBits;
+  int sub_bucket = static_cast<int>(value >> shift) - kSubBuckets;
+  return kSubBuckets * (shift + 1) + sub_bucket;
+}
+
+uint64_t FrameTimingRing::Histogram::ValueForBucket(int bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  int shift = bucket / kSubBuckets - 1;
+  uint64_t sub_bucket = bucket % kSubBuckets + kSubBuckets;
+  // Report the middle of the bucket.
+  return (sub_bucket << shift) + ((1ull << shift) >> 1);
+}
+
+void FrameTimingRing::Histogram::Add(int64_t micros) {
+  counts_[BucketForValue(micros)].fetch_add(1, std::memory_order_relaxed);
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (micros > max &&
+         !max_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+  }
+}
+
+FrameTimingPercentiles FrameTimingRing::Histogram::Collect(size_t* count) {
+  // Frames recorded while the buckets are drained end up in this or the next
+  // collection, but are never lost.
+  uint32_t counts[kBucketCount];
+  uint64_t total = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    counts[i] = counts_[i].exchange(0, std::memory_order_relaxed);
+    total += counts[i];
+  }
+  const int64_t max = max_.exchange(0, std::memory_order_relaxed);
+  if (count) {
+    *count = total;
+  }
+
+  FrameTimingPercentiles percentiles;
+  percentiles.max = fml::TimeDelta::FromMicroseconds(max);
+  if (total == 0) {
+    return percentiles;
+  }
+
+  struct {
+    double quantile;
+    fml::TimeDelta* result;
+  } targets[] = {{0.50, &percentiles.p50},
+                 {0.90, &percentiles.p90},
+                 {0.99, &percentiles.p99}};
+  uint64_t seen = 0;
+  size_t target = 0;
+  for (int i = 0; i < kBucketCount && target < 3; i++) {
+    seen += counts[i];
+    while (target < 3 && seen >= targets[target].quantile * total) {
+      int64_t value = std::min<int64_t>(ValueForBucket(i), max);
+      *targets[target].result = fml::TimeDelta::FromMicroseconds(value);
+      target++;
+    }
+  }
+  return percentiles;
+}
+
+}  // namespace flutter
@@ -0,0 +1,104 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_SHELL_COMMON_FRAME_TIMING_RING_H_
+#define FLUTTER_SHELL_COMMON_FRAME_TIMING_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flutter/common/settings.h"
+#include "flutter/fml/macros.h"
+#include "flutter/fml/time/time_delta.h"
+
+namespace flutter {
+
+struct FrameTimingPercentiles {
+  fml::TimeDelta p50;
+  fml::TimeDelta p90;
+  fml::TimeDelta p99;
+  fml::TimeDelta max;
+};
+
+struct FrameTimingStats {
+  size_t frame_count = 0;
+  FrameTimingPercentiles build;
+  FrameTimingPercentiles raster;
+};
+
+// Keeps the timings of the most recently rasterized frames and aggregates the
+// build and raster durations of all frames into histograms, so that jank
+// metrics can be pulled periodically instead of being pushed to the embedder
+// once per frame.
+//
+// The ring is shared by the engines of a project, so |Record| may be called
+// from the raster threads of several engines at the same time. Frames are
+// ordered by the time |Record| was called. All methods may be called from any
+// thread at the same time and never block the recording threads.
+class FrameTimingRing {
+ public:
+  static constexpr size_t kCapacity = 256;
+
+  FrameTimingRing();
+
+  ~FrameTimingRing();
+
+  void Record(const FrameTiming& timing);
+
+  // The number of frames recorded so far.
+  uint64_t GetFrameCount() const;
+
+  // Returns up to |max_count| of the most recently recorded frames, oldest
+  // first. Frames being overwritten while they are copied are skipped.
+  std::vector<FrameTiming> GetRecentFrames(size_t max_count) const;
+
+  // Returns the statistics of the frames recorded since the previous call and
+  // resets the histograms. Percentiles have a relative error of at most 1/16.
+  FrameTimingStats CollectStats();
+
+ private:
+  // A log-linear histogram of durations in microseconds. Each power of two is
+  // split into |kSubBuckets| linear buckets.
+  class Histogram {
+   public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = kSubBuckets * (64 - kSubBucketBits + 1);
+
+    void Add(int64_t micros);
+
+    FrameTimingPercentiles Collect(size_t* count);
+
+   private:
+    std::atomic<uint32_t> counts_[kBucketCount] = {};
+    std::atomic<int64_t> max_{0};
+
+    static int BucketForValue(uint64_t value);
+
+    static uint64_t ValueForBucket(int bucket);
+  };
+
+  struct Slot {
+    // Even while the slot is stable. Holds 2 * (frame index + 1) once the
+    // frame has been written, and 2 * frame index + 1 while a writer owns it.
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> phases[FrameTiming::kCount] = {};
+  };
+
+  Slot slots_[kCapacity];
+  // The index handed to the next writer.
+  std::atomic<uint64_t> next_index_{0};
+  // One past the highest index written so far.
+  std::atomic<uint64_t> frame_count_{0};
+  Histogram build_;
+  Histogram raster_;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(FrameTimingRing);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_SHELL_COMMON_FRAME_TIMING_RING_H_
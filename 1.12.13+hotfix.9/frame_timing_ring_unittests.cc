@@ -0,0 +1,164 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/frame_timing_ring.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace flutter {
+namespace testing {
+
+// A frame whose build took |build_micros| and whose raster took twice as long.
+// |index| is stored in every phase so that torn reads can be detected.
+static FrameTiming MakeFrame(int64_t index, int64_t build_micros) {
+  auto at = [index](int64_t micros) {
+    return fml::TimePoint::FromEpochDelta(
+        fml::TimeDelta::FromMicroseconds(index * 1000000 + micros));
+  };
+  FrameTiming timing;
+  timing.Set(FrameTiming::kBuildStart, at(0));
+  timing.Set(FrameTiming::kBuildFinish, at(build_micros));
+  timing.Set(FrameTiming::kRasterStart, at(build_micros));
+  timing.Set(FrameTiming::kRasterFinish, at(3 * build_micros));
+  return timing;
+}
+
+static int64_t FrameIndex(const FrameTiming& timing) {
+  return timing.Get(FrameTiming::kBuildStart).ToEpochDelta().ToMicroseconds() /
+         1000000;
+}
+
+TEST(FrameTimingRingTest, ReturnsRecentFramesOldestFirst) {
+  FrameTimingRing ring;
+  EXPECT_TRUE(ring.GetRecentFrames(10).empty());
+
+  for (int64_t i = 0; i < 300; i++) {
+    ring.Record(MakeFrame(i, 100));
+  }
+  EXPECT_EQ(ring.GetFrameCount(), 300u);
+
+  auto frames = ring.GetRecentFrames(10);
+  ASSERT_EQ(frames.size(), 10u);
+  for (size_t i = 0; i < frames.size(); i++) {
+    EXPECT_EQ(FrameIndex(frames[i]), static_cast<int64_t>(290 + i));
+    EXPECT_EQ(frames[i].Get(FrameTiming::kRasterStart),
+              frames[i].Get(FrameTiming::kBuildFinish));
+  }
+
+  frames = ring.GetRecentFrames(1000);
+  ASSERT_EQ(frames.size(), FrameTimingRing::kCapacity);
+  EXPECT_EQ(FrameIndex(frames.front()),
+            static_cast<int64_t>(300 - FrameTimingRing::kCapacity));
+  EXPECT_EQ(FrameIndex(frames.back()), 299);
+}
+
+TEST(FrameTimingRingTest, PercentilesAreWithinTheHistogramError) {
+  FrameTimingRing ring;
+  for (int64_t i = 1; i <= 1000; i++) {
+    ring.Record(MakeFrame(i, i));
+  }
+
+  auto expect_near = [](fml::TimeDelta actual, int64_t expected) {
+    EXPECT_NEAR(actual.ToMicroseconds(), expected, expected / 16.0 + 1);
+  };
+  FrameTimingStats stats = ring.CollectStats();
+  EXPECT_EQ(stats.frame_count, 1000u);
+  expect_near(stats.build.p50, 500);
+  expect_near(stats.build.p90, 900);
+  expect_near(stats.build.p99, 990);
+  EXPECT_EQ(stats.build.max.ToMicroseconds(), 1000);
+  expect_near(stats.raster.p50, 1000);
+  EXPECT_EQ(stats.raster.max.ToMicroseconds(), 2000);
+
+  // Collecting resets the histograms.
+  stats = ring.CollectStats();
+  EXPECT_EQ(stats.frame_count, 0u);
+  EXPECT_EQ(stats.build.max.ToMicroseconds(), 0);
+}
+
+TEST(FrameTimingRingTest, ReadersNeverSeeTornFrames) {
+  FrameTimingRing ring;
+  constexpr int64_t kFrameCount = 20000;
+  std::atomic<bool> done{false};
+
+  std::thread reader([&]() {
+    while (!done.load()) {
+      int64_t previous = -1;
+      for (const FrameTiming& frame : ring.GetRecentFrames(64)) {
+        int64_t index = FrameIndex(frame);
+        EXPECT_GT(index, previous);
+        previous = index;
+        EXPECT_EQ(frame.Get(FrameTiming::kRasterFinish) -
+                      frame.Get(FrameTiming::kBuildStart),
+                  fml::TimeDelta::FromMicroseconds(3 * (index % 100 + 1)));
+        EXPECT_EQ(frame.Get(FrameTiming::kRasterStart),
+                  frame.Get(FrameTiming::kBuildFinish));
+      }
+      ring.CollectStats();
+    }
+  });
+
+  for (int64_t i = 0; i < kFrameCount; i++) {
+    ring.Record(MakeFrame(i, i % 100 + 1));
+  }
+  done.store(true);
+  reader.join();
+  EXPECT_EQ(ring.GetFrameCount(), static_cast<uint64_t>(kFrameCount));
+}
+
+TEST(FrameTimingRingTest, EnginesRecordIntoTheSameRingConcurrently) {
+  FrameTimingRing ring;
+  constexpr int64_t kEngineCount = 4;
+  constexpr int64_t kFramesPerEngine = 5000;
+  std::atomic<bool> done{false};
+
+  std::thread reader([&]() {
+    while (!done.load()) {
+      for (const FrameTiming& frame : ring.GetRecentFrames(64)) {
+        int64_t index = FrameIndex(frame);
+        EXPECT_EQ(frame.Get(FrameTiming::kRasterFinish) -
+                      frame.Get(FrameTiming::kBuildStart),
+                  fml::TimeDelta::FromMicroseconds(3 * (index % 100 + 1)));
+        EXPECT_EQ(frame.Get(FrameTiming::kRasterStart),
+                  frame.Get(FrameTiming::kBuildFinish));
+      }
+    }
+  });
+
+  // Each engine records frames of its own range of indices.
+  std::vector<std::thread> engines;
+  for (int64_t engine = 0; engine < kEngineCount; engine++) {
+    engines.emplace_back([&ring, engine]() {
+      for (int64_t i = 0; i < kFramesPerEngine; i++) {
+        int64_t index = engine * kFramesPerEngine + i;
+        ring.Record(MakeFrame(index, index % 100 + 1));
+      }
+    });
+  }
+  for (auto& engine : engines) {
+    engine.join();
+  }
+  done.store(true);
+  reader.join();
+
+  EXPECT_EQ(ring.GetFrameCount(),
+            static_cast<uint64_t>(kEngineCount * kFramesPerEngine));
+  EXPECT_EQ(ring.CollectStats().frame_count,
+            static_cast<size_t>(kEngineCount * kFramesPerEngine));
+  // A frame is only dropped from the ring when its slot is still being
+  // written with an older frame, which is rare.
+  auto frames = ring.GetRecentFrames(FrameTimingRing::kCapacity);
+  EXPECT_GT(frames.size(), FrameTimingRing::kCapacity / 2);
+  for (const FrameTiming& frame : frames) {
+    EXPECT_EQ(frame.Get(FrameTiming::kRasterStart),
+              frame.Get(FrameTiming::kBuildFinish));
+  }
+}
+
+}  // namespace testing
+}  // namespace flutter
@@ -0,0 +1,207 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/idle_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace flutter {
+
+// Each idle period an item is passed over counts as this fraction of a
+// priority level. A low priority item outranks pending high priority items
+// after twice this many idle periods.
+static constexpr int64_t kAgingPeriodsPerPriority = 4;
+
+// Time kept free at the end of every idle period to absorb scheduling jitter.
+static constexpr int64_t kSafetyMarginMicros = 500;
+
+// Weight of a cheaper than estimated chunk in the cost estimate, as 1/N.
+static constexpr int64_t kEstimateSmoothing = 4;
+
+// Share of its estimate that an item which did not fit in an idle period
+// loses, as 1/N.
+static constexpr int64_t kWaitingEstimateDecay = 8;
+
+// An item passed over for this many idle periods is reported as overdue, so
+// that it runs outside of idle time.
+static constexpr int64_t kMaxPassedOverPeriods = 16;
+
+IdleScheduler::IdleScheduler(Clock clock, OverdueCallback overdue_callback)
+    : clock_(std::move(clock)),
+      overdue_callback_(std::move(overdue_callback)) {}
+
+IdleScheduler::~IdleScheduler() = default;
+
+IdleScheduler::ItemId IdleScheduler::Register(
+    std::string name,
+    Priority priority,
+    fml::TimeDelta estimated_chunk_cost,
+    Work work) {
+  if (!work) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Item item;
+  item.id = next_id_++;
+  item.name = std::move(name);
+  item.priority = priority;
+  item.estimate_micros =
+      std::max<int64_t>(estimated_chunk_cost.ToMicroseconds(), 1);
+  item.work = std::move(work);
+  items_.push_back(std::move(item));
+  return items_.back().id;
+}
+
+void IdleScheduler::Unregister(ItemId id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  items_.erase(std::remove_if(items_.begin(), items_.end(),
+                              [id](const Item& item) { return item.id == id; }),
+               items_.end());
+}
+
+size_t IdleScheduler::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return items_.size();
+}
+
+int64_t IdleScheduler::PickOverdueLocked() const {
+  int64_t oldest = -1;
+  for (size_t i = 0; i < items_.size(); i++) {
+    const Item& item = items_[i];
+    if (item.age >= kMaxPassedOverPeriods &&
+        (oldest < 0 || item.age > items_[oldest].age)) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+int64_t IdleScheduler::PickLocked(int64_t remaining_micros) const {
+  int64_t best = -1;
+  int64_t best_rank = 0;
+  for (size_t i = 0; i < items_.size(); i++) {
+    const Item& item = items_[i];
+    if (item.ran_this_round || item.estimate_micros > remaining_micros) {
+      continue;
+    }
+    int64_t rank =
+        static_cast<int64_t>(item.priority) * kAgingPeriodsPerPriority +
+        item.age;
+    if (best < 0 || rank > best_rank) {
+      best = i;
+      best_rank = rank;
+    }
+  }
+  return best;
+}
+
+void IdleScheduler::RunChunkLocked(std::unique_lock<std::mutex>& lock,
+                                   size_t index,
+                                   int64_t budget_micros) {
+  Item& item = items_[index];
+  item.ran_this_round = true;
+  item.ran_this_period = true;
+  item.age = 0;
+  const ItemId id = item.id;
+  Work work = item.work;
+  lock.unlock();
+
+  const int64_t start = clock_();
+  const bool more = work(
+      fml::TimeDelta::FromMicroseconds(std::max<int64_t>(budget_micros, 0)));
+  const int64_t cost = std::max<int64_t>(clock_() - start, 1);
+
+  lock.lock();
+  // The item may have been unregistered while it ran.
+  auto found = std::find_if(items_.begin(), items_.end(),
+                            [id](const Item& item) { return item.id == id; });
+  if (found == items_.end()) {
+    return;
+  }
+  if (!more) {
+    items_.erase(found);
+    return;
+  }
+  // Overruns are taken into account immediately, cheaper chunks lower the
+  // estimate gradually.
+  if (cost > found->estimate_micros) {
+    found->estimate_micros = cost;
+  } else {
+    found->estimate_micros -=
+        (found->estimate_micros - cost) / kEstimateSmoothing;
+  }
+}
+
+size_t IdleScheduler::RunUntil(int64_t deadline_micros) {
+  size_t chunks = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& item : items_) {
+    item.ran_this_round = false;
+    item.ran_this_period = false;
+  }
+
+  const int64_t period_micros =
+      deadline_micros - clock_() - kSafetyMarginMicros;
+  if (period_micros <= 0) {
+    return 0;
+  }
+
+  // Every item gets at most one chunk per round, so that one item with a lot
+  // of work does not crowd out the others. Rounds repeat while chunks still
+  // fit in the idle period.
+  bool round_ran_chunks = false;
+  while (true) {
+    const int64_t remaining = deadline_micros - clock_() - kSafetyMarginMicros;
+    const int64_t index = PickLocked(remaining);
+    if (index < 0) {
+      if (!round_ran_chunks) {
+        break;
+      }
+      round_ran_chunks = false;
+      for (auto& item : items_) {
+        item.ran_this_round = false;
+      }
+      continue;
+    }
+    RunChunkLocked(lock, index, remaining);
+    chunks++;
+    round_ran_chunks = true;
+  }
+
+  // Items that did not get to run in this idle period move up. The estimate
+  // of an item that did not fit in the whole period decays, as it may only
+  // reflect a chunk that was unusually slow.
+  for (auto& item : items_) {
+    if (item.ran_this_period) {
+      continue;
+    }
+    item.age++;
+    if (item.estimate_micros > period_micros) {
+      item.estimate_micros -= item.estimate_micros / kWaitingEstimateDecay;
+    }
+  }
+
+  if (overdue_callback_ && !overdue_reported_ && PickOverdueLocked() >= 0) {
+    overdue_reported_ = true;
+    lock.unlock();
+    overdue_callback_();
+  }
+  return chunks;
+}
+
+bool IdleScheduler::RunOverdue() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  overdue_reported_ = false;
+  const int64_t index = PickOverdueLocked();
+  if (index < 0) {
+    return false;
+  }
+  // Outside of idle time there is no deadline, so the chunk is given what it
+  // is expected to need.
+  RunChunkLocked(lock, index, items_[index].estimate_micros);
+  return true;
+}
+
+}  // namespace flutter
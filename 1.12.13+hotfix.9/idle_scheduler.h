@@ -0,0 +1,120 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_SHELL_COMMON_IDLE_SCHEDULER_H_
+#define FLUTTER_SHELL_COMMON_IDLE_SCHEDULER_H_
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "flutter/fml/macros.h"
+#include "flutter/fml/time/time_delta.h"
+
+namespace flutter {
+
+// Runs deferrable work of several subsystems (cache trimming, page release,
+// prefetching, ...) in the idle time the framework leaves between frames.
+//
+// Work is split into chunks. A chunk is only started if its estimated cost
+// fits in what is left of the idle period, and the estimate of each item
+// tracks the cost of its recent chunks. Items are picked by priority, but
+// every idle period an item is passed over increases its effective priority
+// so that low priority work cannot be starved by a steady stream of higher
+// priority work. The estimate of an item that does not fit in an idle period
+// decays while it waits. Work too large for the idle periods on offer is never
+// run inside one. Once an item has been passed over for too long, the
+// scheduler reports it through its |OverdueCallback| instead, and the embedder
+// runs it outside of idle time with |RunOverdue|.
+//
+// Items may be registered and unregistered from any thread. |RunUntil| and
+// |RunOverdue| must be called on the thread the work should run on, usually
+// the UI thread from |Settings::idle_notification_callback|.
+class IdleScheduler {
+ public:
+  enum class Priority { kLow = 0, kNormal = 1, kHigh = 2 };
+
+  // Performs one chunk of work that should take no longer than |budget|.
+  // Returns true if the item has more work to do.
+  using Work = std::function<bool(fml::TimeDelta budget)>;
+
+  // Returns the current time in microseconds, in the time base of the idle
+  // deadlines.
+  using Clock = std::function<int64_t()>;
+
+  // Called from |RunUntil| when an item has been passed over for so long that
+  // it should run outside of idle time. It is not called again until
+  // |RunOverdue| has been called.
+  using OverdueCallback = std::function<void()>;
+
+  using ItemId = uint64_t;
+
+  explicit IdleScheduler(Clock clock,
+                         OverdueCallback overdue_callback = nullptr);
+
+  ~IdleScheduler();
+
+  // Adds a work item. |estimated_chunk_cost| is the expected cost of a chunk
+  // until actual costs have been measured.
+  ItemId Register(std::string name,
+                  Priority priority,
+                  fml::TimeDelta estimated_chunk_cost,
+                  Work work);
+
+  void Unregister(ItemId id);
+
+  // Runs chunks of pending work until none fits before |deadline_micros|.
+  // Returns the number of chunks run.
+  size_t RunUntil(int64_t deadline_micros);
+
+  // Runs a chunk of the item that has been passed over for the most idle
+  // periods, if it has waited for too long. This is not bound by an idle
+  // deadline, so it should be called from a regular task. Returns true if a
+  // chunk was run.
+  bool RunOverdue();
+
+  size_t GetPendingCount() const;
+
+ private:
+  struct Item {
+    ItemId id;
+    std::string name;
+    Priority priority;
+    int64_t estimate_micros;
+    Work work;
+    // The number of idle periods in which the item was passed over.
+    int64_t age = 0;
+    bool ran_this_round = false;
+    bool ran_this_period = false;
+  };
+
+  const Clock clock_;
+  const OverdueCallback overdue_callback_;
+  mutable std::mutex mutex_;
+  std::vector<Item> items_;
+  ItemId next_id_ = 1;
+  bool overdue_reported_ = false;
+
+  // Returns the index of the item that has been passed over for the most
+  // idle periods if it has waited for too long, or -1.
+  int64_t PickOverdueLocked() const;
+
+  // Returns the index of the item to run next among those whose estimate
+  // fits in |remaining_micros|, or -1.
+  int64_t PickLocked(int64_t remaining_micros) const;
+
+  // Runs a chunk of the item at |index| with the lock released, and updates
+  // or drops the item afterwards.
+  void RunChunkLocked(std::unique_lock<std::mutex>& lock,
+                      size_t index,
+                      int64_t budget_micros);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(IdleScheduler);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_SHELL_COMMON_IDLE_SCHEDULER_H_
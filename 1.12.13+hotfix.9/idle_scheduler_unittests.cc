@@ -0,0 +1,226 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/idle_scheduler.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace flutter {
+namespace testing {
+
+// Simulates the UI thread: work advances a fake clock by what it costs, and
+// idle periods of a given length follow each other. Overdue work is run as a
+// regular task after the frame that follows an idle period.
+class SimulatedIdleTime {
+ public:
+  SimulatedIdleTime()
+      : scheduler_([this]() { return now_; },
+                   [this]() { overdue_reported_ = true; }) {}
+
+  IdleScheduler& scheduler() { return scheduler_; }
+
+  // Work whose chunks each cost |cost_micros| and that has |chunks| of them.
+  IdleScheduler::Work MakeWork(int64_t cost_micros,
+                               int chunks,
+                               std::vector<int64_t>* start_times = nullptr) {
+    auto remaining = std::make_shared<int>(chunks);
+    return [this, cost_micros, remaining, start_times](fml::TimeDelta budget) {
+      if (start_times) {
+        start_times->push_back(now_);
+      }
+      now_ += cost_micros;
+      return --*remaining > 0;
+    };
+  }
+
+  // Runs one idle period of |length_micros| followed by a frame, and overdue
+  // work if any was reported. Returns the number of chunks run in the idle
+  // period.
+  size_t RunIdlePeriod(int64_t length_micros) {
+    const int64_t deadline = now_ + length_micros;
+    size_t chunks = scheduler_.RunUntil(deadline);
+    overrun_ = std::max(overrun_, now_ - deadline);
+    now_ = std::max(now_, deadline) + 16000;
+    if (overdue_reported_) {
+      overdue_reported_ = false;
+      if (scheduler_.RunOverdue()) {
+        overdue_chunks_++;
+      }
+    }
+    return chunks;
+  }
+
+  // The most any idle period was overrun by.
+  int64_t max_overrun() const { return overrun_; }
+
+  // The number of chunks run outside of idle periods.
+  size_t overdue_chunks() const { return overdue_chunks_; }
+
+ private:
+  int64_t now_ = 1000000;
+  int64_t overrun_ = 0;
+  bool overdue_reported_ = false;
+  size_t overdue_chunks_ = 0;
+  IdleScheduler scheduler_;
+};
+
+TEST(IdleSchedulerTest, RunsChunksThatFitBeforeTheDeadline) {
+  SimulatedIdleTime idle;
+  std::vector<int64_t> starts;
+  idle.scheduler().Register("fits", IdleScheduler::Priority::kNormal,
+                            fml::TimeDelta::FromMicroseconds(1000),
+                            idle.MakeWork(1000, 100, &starts));
+
+  // 10ms minus the safety margin leaves room for 9 chunks.
+  EXPECT_EQ(idle.RunIdlePeriod(10000), 9u);
+  EXPECT_LE(idle.max_overrun(), 0);
+  EXPECT_EQ(idle.scheduler().GetPendingCount(), 1u);
+
+  // Finished items are dropped.
+  while (idle.scheduler().GetPendingCount() > 0) {
+    idle.RunIdlePeriod(10000);
+  }
+  EXPECT_EQ(starts.size(), 100u);
+  EXPECT_LE(idle.max_overrun(), 0);
+}
+
+TEST(IdleSchedulerTest, LearnsFromOverrunsImmediately) {
+  SimulatedIdleTime idle;
+  // Estimated at 1ms but costs 4ms.
+  std::vector<int64_t> starts;
+  idle.scheduler().Register("underestimated", IdleScheduler::Priority::kNormal,
+                            fml::TimeDelta::FromMicroseconds(1000),
+                            idle.MakeWork(4000, 100, &starts));
+
+  // The first chunk overruns the estimate, after which only chunks that fit
+  // are started.
+  EXPECT_EQ(idle.RunIdlePeriod(6000), 1u);
+  EXPECT_EQ(idle.RunIdlePeriod(10000), 2u);
+  EXPECT_LE(idle.max_overrun(), 0);
+}
+
+TEST(IdleSchedulerTest, LowPriorityWorkIsNotStarvedByHigherPriorityWork) {
+  SimulatedIdleTime idle;
+  std::vector<int64_t> low_starts;
+  idle.scheduler().Register("high", IdleScheduler::Priority::kHigh,
+                            fml::TimeDelta::FromMicroseconds(3000),
+                            idle.MakeWork(3000, 1000));
+  idle.scheduler().Register("low", IdleScheduler::Priority::kLow,
+                            fml::TimeDelta::FromMicroseconds(3000),
+                            idle.MakeWork(3000, 1000, &low_starts));
+
+  // Each idle period only has room for a single chunk.
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(idle.RunIdlePeriod(4000), 1u);
+  }
+  EXPECT_FALSE(low_starts.empty());
+  EXPECT_LE(idle.max_overrun(), 0);
+}
+
+TEST(IdleSchedulerTest, OverestimatedWorkIsRetriedAsItsEstimateDecays) {
+  SimulatedIdleTime idle;
+  // Estimated at 20ms, actually 2ms.
+  std::vector<int64_t> starts;
+  idle.scheduler().Register("overestimated", IdleScheduler::Priority::kNormal,
+                            fml::TimeDelta::FromMicroseconds(20000),
+                            idle.MakeWork(2000, 100, &starts));
+
+  int periods = 0;
+  while (starts.empty() && periods < 100) {
+    idle.RunIdlePeriod(5000);
+    periods++;
+  }
+  ASSERT_FALSE(starts.empty());
+  // The decay alone lets it run well before it becomes overdue.
+  EXPECT_LT(periods, 16);
+  EXPECT_LE(idle.max_overrun(), 0);
+
+  // Once measured it runs in every idle period.
+  starts.clear();
+  for (int i = 0; i < 10; i++) {
+    idle.RunIdlePeriod(5000);
+  }
+  EXPECT_GE(starts.size(), 10u);
+}
+
+TEST(IdleSchedulerTest, WorkLargerThanAnyIdlePeriodEventuallyRuns) {
+  SimulatedIdleTime idle;
+  // Every chunk costs 100ms but idle periods are only 4ms long, so decaying
+  // the estimate alone would take a long time.
+  std::vector<int64_t> starts;
+  idle.scheduler().Register("large", IdleScheduler::Priority::kHigh,
+                            fml::TimeDelta::FromMicroseconds(100000),
+                            idle.MakeWork(100000, 3, &starts));
+
+  int periods = 0;
+  while (idle.scheduler().GetPendingCount() > 0 && periods < 100) {
+    idle.RunIdlePeriod(4000);
+    periods++;
+  }
+  EXPECT_EQ(starts.size(), 3u);
+  // Run outside of idle time after being passed over for 16 idle periods each
+  // time, so that no idle period is overrun.
+  EXPECT_LE(periods, 3 * 17);
+  EXPECT_EQ(idle.overdue_chunks(), 3u);
+  EXPECT_LE(idle.max_overrun(), 0);
+}
+
+TEST(IdleSchedulerTest, OverdueWorkRunsOutsideOfIdlePeriods) {
+  SimulatedIdleTime idle;
+  std::vector<int64_t> large_starts;
+  std::vector<int64_t> small_starts;
+  idle.scheduler().Register("large", IdleScheduler::Priority::kNormal,
+                            fml::TimeDelta::FromMicroseconds(100000),
+                            idle.MakeWork(100000, 1000, &large_starts));
+  idle.scheduler().Register("small", IdleScheduler::Priority::kNormal,
+                            fml::TimeDelta::FromMicroseconds(500),
+                            idle.MakeWork(500, 1000, &small_starts));
+
+  for (int i = 0; i < 200; i++) {
+    idle.RunIdlePeriod(4000);
+  }
+  // The large item runs outside of idle time every so often, and the small
+  // item keeps running in the idle periods meanwhile.
+  EXPECT_GE(large_starts.size(), 10u);
+  EXPECT_LE(large_starts.size(), 12u);
+  EXPECT_EQ(idle.overdue_chunks(), large_starts.size());
+  EXPECT_GT(small_starts.size(), 200u);
+  EXPECT_LE(idle.max_overrun(), 0);
+}
+
+TEST(IdleSchedulerTest, DoesNothingWithoutIdleTime) {
+  SimulatedIdleTime idle;
+  std::vector<int64_t> starts;
+  idle.scheduler().Register("work", IdleScheduler::Priority::kHigh,
+                            fml::TimeDelta::FromMicroseconds(100),
+                            idle.MakeWork(100, 10, &starts));
+  for (int i = 0; i < 50; i++) {
+    EXPECT_EQ(idle.RunIdlePeriod(0), 0u);
+  }
+  EXPECT_TRUE(starts.empty());
+}
+
+TEST(IdleSchedulerTest, ItemsMayBeUnregisteredWhileRunning) {
+  SimulatedIdleTime idle;
+  IdleScheduler::ItemId id = 0;
+  int runs = 0;
+  id = idle.scheduler().Register(
+      "self removing", IdleScheduler::Priority::kNormal,
+      fml::TimeDelta::FromMicroseconds(100),
+      [&idle, &id, &runs](fml::TimeDelta budget) {
+        runs++;
+        idle.scheduler().Unregister(id);
+        return true;
+      });
+  EXPECT_EQ(idle.RunIdlePeriod(10000), 1u);
+  EXPECT_EQ(runs, 1);
+  EXPECT_EQ(idle.scheduler().GetPendingCount(), 0u);
+}
+
+}  // namespace testing
+}  // namespace flutter
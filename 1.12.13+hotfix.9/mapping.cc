@@ -7,10 +7,69 @@
 #include <algorithm>
 #include <sstream>
 
+#if !OS_WIN
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // !OS_WIN
+
 namespace fml {
 
+// Mapping
+
+bool Mapping::ReleaseResidentPages() const {
+  return false;
+}
+
 // FileMapping
 
+bool FileMapping::ReleaseResidentPages() const {
+#if OS_WIN
+  return false;
+#else   // OS_WIN
+  // Writable mappings may hold private modifications that would be lost.
+  if (mapping_ == nullptr || mutable_mapping_ != nullptr || size_ == 0) {
+    return false;
+  }
+  return ::madvise(mapping_, size_, MADV_DONTNEED) == 0;
+#endif  // OS_WIN
+}
+
+bool FileMapping::AdviseRandomAccess() const {
+#if OS_WIN
+  return false;
+#else   // OS_WIN
+  if (mapping_ == nullptr || size_ == 0) {
+    return false;
+  }
+  return ::madvise(mapping_, size_, MADV_RANDOM) == 0;
+#endif  // OS_WIN
+}
+
+size_t FileMapping::GetResidentSize() const {
+#if OS_WIN
+  return 0;
+#else   // OS_WIN
+  if (mapping_ == nullptr || size_ == 0) {
+    return 0;
+  }
+  const size_t page_size = ::getpagesize();
+  std::vector<unsigned char> residency((size_ + page_size - 1) / page_size);
+#if OS_MACOSX || OS_IOS
+  char* vector = reinterpret_cast<char*>(residency.data());
+#else   // OS_MACOSX || OS_IOS
+  unsigned char* vector = residency.data();
+#endif  // OS_MACOSX || OS_IOS
+  if (::mincore(mapping_, size_, vector) != 0) {
+    return 0;
+  }
+  size_t resident_pages = 0;
+  for (unsigned char page : residency) {
+    resident_pages += page & 1;
+  }
+  return std::min(resident_pages * page_size, size_);
+#endif  // OS_WIN
+}
+
 uint8_t* FileMapping::GetMutableMapping() {
   return mutable_mapping_;
 }
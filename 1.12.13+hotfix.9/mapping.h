@@ -28,6 +28,12 @@ class Mapping {
 
   virtual const uint8_t* GetMapping() const = 0;
 
+  // Drops the pages of this mapping from the resident set of the process. This
+  // is only done for mappings whose contents can be faulted back in from their
+  // backing store, so callers may keep using the mapping afterwards. Returns
+  // true if the pages were released.
+  virtual bool ReleaseResidentPages() const;
+
  private:
   FML_DISALLOW_COPY_AND_ASSIGN(Mapping);
 };
@@ -65,6 +71,17 @@ class FileMapping final : public Mapping {
   // |Mapping|
   const uint8_t* GetMapping() const override;
 
+  // |Mapping|
+  bool ReleaseResidentPages() const override;
+
+  // Hints to the OS that the mapping will be accessed sparsely so that only
+  // the pages actually touched are faulted in, without read-ahead.
+  bool AdviseRandomAccess() const;
+
+  // Returns the number of bytes of this mapping that are currently resident,
+  // rounded to whole pages, or zero if that cannot be determined.
+  size_t GetResidentSize() const;
+
   uint8_t* GetMutableMapping();
 
   bool IsValid() const;
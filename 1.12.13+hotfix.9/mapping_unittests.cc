@@ -0,0 +1,56 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/mapping.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "flutter/fml/build_config.h"
+#include "flutter/fml/file.h"
+#include "gtest/gtest.h"
+
+namespace fml {
+namespace testing {
+
+#if OS_LINUX
+
+TEST(FileMappingTest, ReleasedPagesAreNoLongerResident) {
+  const size_t page_size = ::getpagesize();
+  const size_t size = 64 * page_size;
+  ScopedTemporaryDirectory directory;
+  ASSERT_TRUE(WriteAtomically(directory.fd(), "pages",
+                              DataMapping(std::vector<uint8_t>(size, 1))));
+  auto fd = OpenFile(directory.fd(), "pages", false, FilePermission::kRead);
+  ASSERT_TRUE(fd.is_valid());
+  auto mapping = FileMapping::CreateReadOnly(fd, "");
+  ASSERT_TRUE(mapping);
+  ASSERT_EQ(mapping->GetSize(), size);
+
+  volatile uint8_t sink = 0;
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    sink = sink + mapping->GetMapping()[offset];
+  }
+  EXPECT_EQ(mapping->GetResidentSize(), size);
+
+  // mincore reports the page cache, which keeps pages that are mapped.
+  ASSERT_EQ(::posix_fadvise(fd.get(), 0, 0, POSIX_FADV_DONTNEED), 0);
+  EXPECT_EQ(mapping->GetResidentSize(), size);
+
+  // Once released, the pages are no longer mapped and can be reclaimed, as
+  // they would be under memory pressure.
+  ASSERT_TRUE(mapping->ReleaseResidentPages());
+  ASSERT_EQ(::posix_fadvise(fd.get(), 0, 0, POSIX_FADV_DONTNEED), 0);
+  EXPECT_LT(mapping->GetResidentSize(), size / 2);
+
+  // The data is read back from the file when touched again.
+  EXPECT_EQ(mapping->GetMapping()[size - 1], 1u);
+}
+
+#endif  // OS_LINUX
+
+}  // namespace testing
+}  // namespace fml
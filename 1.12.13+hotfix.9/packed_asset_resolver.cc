@@ -0,0 +1,255 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/assets/packed_asset_resolver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "flutter/fml/logging.h"
+#include "third_party/zlib/zlib.h"
+
+namespace flutter {
+
+constexpr char PackedAssetResolver::kArchiveFileName[];
+constexpr size_t PackedAssetResolver::kDefaultCacheCapacity;
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'L', 'T', 'A'};
+constexpr uint32_t kVersion = 2;
+
+// No asset in a bundle comes close to this, so a larger size can only come
+// from a corrupt archive.
+constexpr uint64_t kMaxDecompressedSize = 256 << 20;
+
+// Deflate cannot shrink data by more than this factor.
+constexpr uint64_t kMaxCompressionRatio = 1032;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t reserved;
+  uint64_t index_offset;
+  uint64_t names_offset;
+};
+
+static_assert(sizeof(Header) == 32, "The header is read in place.");
+
+}  // namespace
+
+uint64_t PackedAssetResolver::HashName(const std::string& name) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (unsigned char c : name) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::unique_ptr<PackedAssetResolver> PackedAssetResolver::Create(
+    std::shared_ptr<const fml::Mapping> archive,
+    size_t cache_capacity) {
+  if (!archive) {
+    return nullptr;
+  }
+  std::unique_ptr<PackedAssetResolver> resolver(
+      new PackedAssetResolver(std::move(archive), cache_capacity));
+  if (!resolver->Parse()) {
+    return nullptr;
+  }
+  return resolver;
+}
+
+PackedAssetResolver::PackedAssetResolver(
+    std::shared_ptr<const fml::Mapping> archive,
+    size_t cache_capacity)
+    : archive_(std::move(archive)), cache_capacity_(cache_capacity) {}
+
+PackedAssetResolver::~PackedAssetResolver() = default;
+
+bool PackedAssetResolver::Parse() {
+  static_assert(sizeof(Entry) == 40, "Index entries are read in place.");
+
+  const uint8_t* data = archive_->GetMapping();
+  const size_t size = archive_->GetSize();
+  if (data == nullptr || size < sizeof(Header)) {
+    return false;
+  }
+
+  Header header;
+  ::memcpy(&header, data, sizeof(header));
+  if (::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    return false;
+  }
+
+  const uint64_t index_size =
+      static_cast<uint64_t>(header.entry_count) * sizeof(Entry);
+  if (header.index_offset % alignof(Entry) != 0 ||
+      header.index_offset > size || index_size > size - header.index_offset ||
+      header.names_offset > size) {
+    return false;
+  }
+
+  entries_ = reinterpret_cast<const Entry*>(data + header.index_offset);
+  entry_count_ = header.entry_count;
+  names_ = reinterpret_cast<const char*>(data + header.names_offset);
+  names_size_ = size - header.names_offset;
+
+  // Validate every entry once so that lookups need no bounds checks.
+  for (size_t i = 0; i < entry_count_; i++) {
+    const Entry& entry = entries_[i];
+    if (entry.name_offset > names_size_ ||
+        entry.name_length > names_size_ - entry.name_offset ||
+        entry.data_offset > size ||
+        entry.stored_size > size - entry.data_offset) {
+      return false;
+    }
+    switch (entry.codec) {
+      case Codec::kStored:
+        if (entry.stored_size != entry.size) {
+          return false;
+        }
+        break;
+      case Codec::kZlib:
+        if (entry.size > std::numeric_limits<uLong>::max() ||
+            entry.stored_size > std::numeric_limits<uLong>::max()) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+    if (i > 0 && entries_[i - 1].name_hash > entry.name_hash) {
+      return false;
+    }
+  }
+  return true;
+}
+
+PackedAssetResolver::CacheStats PackedAssetResolver::GetCacheStats() const {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  return cache_stats_;
+}
+
+const PackedAssetResolver::Entry* PackedAssetResolver::FindEntry(
+    const std::string& asset_name) const {
+  const uint64_t hash = HashName(asset_name);
+  const Entry* end = entries_ + entry_count_;
+  const Entry* entry = std::lower_bound(
+      entries_, end, hash,
+      [](const Entry& entry, uint64_t hash) { return entry.name_hash < hash; });
+
+  for (; entry != end && entry->name_hash == hash; entry++) {
+    if (entry->name_length == asset_name.size() &&
+        ::memcmp(names_ + entry->name_offset, asset_name.data(),
+                 asset_name.size()) == 0) {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<fml::DataMapping> PackedAssetResolver::Decompress(
+    const Entry& entry) const {
+  // Check the size before allocating for it.
+  if (entry.size > kMaxDecompressedSize ||
+      entry.size > entry.stored_size * kMaxCompressionRatio) {
+    FML_LOG(ERROR) << "Packed asset claims an implausible size of "
+                   << entry.size << " bytes.";
+    return nullptr;
+  }
+  std::vector<uint8_t> data(entry.size);
+  uLongf size = entry.size;
+  const uint8_t* source = archive_->GetMapping() + entry.data_offset;
+  const int result =
+      ::uncompress(data.data(), &size, source, entry.stored_size);
+  if (result != Z_OK || size != entry.size) {
+    return nullptr;
+  }
+  return std::make_unique<fml::DataMapping>(std::move(data));
+}
+
+std::unique_ptr<fml::Mapping> PackedAssetResolver::GetCompressedAsset(
+    const Entry& entry) const {
+  CachedAsset asset;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto found = cache_index_.find(&entry);
+    if (found != cache_index_.end()) {
+      cache_stats_.hits++;
+      cache_.splice(cache_.begin(), cache_, found->second);
+      asset = found->second->second;
+    } else {
+      cache_stats_.misses++;
+    }
+  }
+
+  if (!asset) {
+    // Inflate outside of the lock. Two threads missing on the same asset both
+    // inflate it, and the second one to finish keeps the cached copy.
+    auto decompressed = Decompress(entry);
+    if (!decompressed) {
+      return nullptr;
+    }
+    if (entry.size > cache_capacity_) {
+      return decompressed;
+    }
+    asset = std::move(decompressed);
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto found = cache_index_.find(&entry);
+    if (found != cache_index_.end()) {
+      cache_.splice(cache_.begin(), cache_, found->second);
+      asset = found->second->second;
+    } else {
+      cache_.emplace_front(&entry, asset);
+      cache_index_[&entry] = cache_.begin();
+      cache_stats_.cached_bytes += entry.size;
+      while (cache_stats_.cached_bytes > cache_capacity_) {
+        const Entry* evicted = cache_.back().first;
+        cache_stats_.cached_bytes -= evicted->size;
+        cache_stats_.evictions++;
+        cache_index_.erase(evicted);
+        cache_.pop_back();
+      }
+    }
+  }
+
+  // Mappings handed out keep their bytes alive past an eviction.
+  return std::make_unique<fml::NonOwnedMapping>(
+      asset->GetMapping(), asset->GetSize(),
+      [asset](const uint8_t*, size_t) {});
+}
+
+// |AssetResolver|
+bool PackedAssetResolver::IsValid() const {
+  // |Create| only hands out resolvers whose archive parsed.
+  return true;
+}
+
+// |AssetResolver|
+std::unique_ptr<fml::Mapping> PackedAssetResolver::GetAsMapping(
+    const std::string& asset_name) const {
+  const Entry* entry = FindEntry(asset_name);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+
+  if (entry->codec == Codec::kZlib) {
+    return GetCompressedAsset(*entry);
+  }
+
+  // The slice keeps the archive alive.
+  auto archive = archive_;
+  return std::make_unique<fml::NonOwnedMapping>(
+      archive_->GetMapping() + entry->data_offset, entry->size,
+      [archive](const uint8_t*, size_t) {});
+}
+
+}  // namespace flutter
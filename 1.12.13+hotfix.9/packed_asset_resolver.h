@@ -0,0 +1,131 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_ASSETS_PACKED_ASSET_RESOLVER_H_
+#define FLUTTER_ASSETS_PACKED_ASSET_RESOLVER_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "flutter/assets/asset_resolver.h"
+#include "flutter/fml/macros.h"
+#include "flutter/fml/mapping.h"
+
+namespace flutter {
+
+// Resolves assets from a single packed asset archive instead of one file per
+// asset. Stored assets are served as slices of the archive mapping, so a lookup
+// is a binary search over the in-memory index and involves no file system
+// access. Compressed assets are inflated on first use and kept in a size
+// bounded LRU cache.
+//
+// Archive layout (little endian), written by the pack step in bundle.dart:
+//
+//   Header
+//     char     magic[4]        "FLTA"
+//     uint32_t version         2
+//     uint32_t entry_count
+//     uint32_t reserved
+//     uint64_t index_offset
+//     uint64_t names_offset
+//   Index, entry_count times, sorted by name_hash then name
+//     uint64_t name_hash       64-bit FNV-1a of the UTF-8 asset name
+//     uint32_t name_offset     relative to names_offset
+//     uint16_t name_length
+//     uint8_t  codec           see |Codec|
+//     uint8_t  reserved
+//     uint64_t data_offset
+//     uint64_t stored_size     bytes in the archive
+//     uint64_t size            bytes once decoded
+//   Names, UTF-8 without terminators
+//   Data, 8 byte aligned. Stored entries of at least a page start on a page
+//   boundary so that their pages can be faulted in and dropped independently.
+class PackedAssetResolver final : public AssetResolver {
+ public:
+  static constexpr char kArchiveFileName[] = "assets.pack";
+  static constexpr size_t kDefaultCacheCapacity = 8 << 20;
+
+  enum class Codec : uint8_t {
+    kStored = 0,
+    // A zlib stream (RFC 1950) holding the deflated asset.
+    kZlib = 1,
+  };
+
+  struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t cached_bytes = 0;
+  };
+
+  // Returns null if |archive| is not a valid packed asset archive. At most
+  // |cache_capacity| bytes of decompressed assets are kept around.
+  static std::unique_ptr<PackedAssetResolver> Create(
+      std::shared_ptr<const fml::Mapping> archive,
+      size_t cache_capacity = kDefaultCacheCapacity);
+
+  ~PackedAssetResolver() override;
+
+  static uint64_t HashName(const std::string& name);
+
+  size_t GetAssetCount() const { return entry_count_; }
+
+  CacheStats GetCacheStats() const;
+
+ private:
+  struct Entry {
+    uint64_t name_hash;
+    uint32_t name_offset;
+    uint16_t name_length;
+    Codec codec;
+    uint8_t reserved;
+    uint64_t data_offset;
+    uint64_t stored_size;
+    uint64_t size;
+  };
+
+  using CachedAsset = std::shared_ptr<const fml::DataMapping>;
+  // Most recently used first.
+  using CacheList = std::list<std::pair<const Entry*, CachedAsset>>;
+
+  const std::shared_ptr<const fml::Mapping> archive_;
+  const size_t cache_capacity_;
+  const Entry* entries_ = nullptr;
+  size_t entry_count_ = 0;
+  const char* names_ = nullptr;
+  size_t names_size_ = 0;
+
+  mutable std::mutex cache_mutex_;
+  mutable CacheList cache_;
+  mutable std::unordered_map<const Entry*, CacheList::iterator> cache_index_;
+  mutable CacheStats cache_stats_;
+
+  PackedAssetResolver(std::shared_ptr<const fml::Mapping> archive,
+                      size_t cache_capacity);
+
+  bool Parse();
+
+  const Entry* FindEntry(const std::string& asset_name) const;
+
+  std::unique_ptr<fml::DataMapping> Decompress(const Entry& entry) const;
+
+  std::unique_ptr<fml::Mapping> GetCompressedAsset(const Entry& entry) const;
+
+  // |AssetResolver|
+  bool IsValid() const override;
+
+  // |AssetResolver|
+  std::unique_ptr<fml::Mapping> GetAsMapping(
+      const std::string& asset_name) const override;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(PackedAssetResolver);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_ASSETS_PACKED_ASSET_RESOLVER_H_
@@ -0,0 +1,188 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/assets/packed_asset_resolver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace flutter {
+namespace testing {
+
+struct TestAsset {
+  std::string name;
+  std::string contents;
+  bool compress = false;
+  // Overrides the decoded size written to the index when non-zero.
+  uint64_t claimed_size = 0;
+};
+
+template <typename T>
+static void Put(std::vector<uint8_t>* archive, size_t offset, T value) {
+  ::memcpy(archive->data() + offset, &value, sizeof(value));
+}
+
+// Writes an archive the way the pack step in bundle.dart does, see the layout
+// in packed_asset_resolver.h.
+static std::vector<uint8_t> MakeArchive(std::vector<TestAsset> assets) {
+  std::sort(assets.begin(), assets.end(),
+            [](const TestAsset& a, const TestAsset& b) {
+              return PackedAssetResolver::HashName(a.name) <
+                     PackedAssetResolver::HashName(b.name);
+            });
+
+  const size_t index_offset = 32;
+  const size_t names_offset = index_offset + assets.size() * 40;
+  std::string names;
+  std::vector<std::string> data;
+  for (const TestAsset& asset : assets) {
+    names += asset.name;
+    if (!asset.compress) {
+      data.push_back(asset.contents);
+      continue;
+    }
+    uLongf size = ::compressBound(asset.contents.size());
+    std::string compressed(size, '\0');
+    EXPECT_EQ(::compress(reinterpret_cast<Bytef*>(&compressed[0]), &size,
+                         reinterpret_cast<const Bytef*>(asset.contents.data()),
+                         asset.contents.size()),
+              Z_OK);
+    compressed.resize(size);
+    data.push_back(compressed);
+  }
+
+  size_t data_offset = (names_offset + names.size() + 7) / 8 * 8;
+  std::vector<uint8_t> archive(data_offset);
+  ::memcpy(archive.data(), "FLTA", 4);
+  Put<uint32_t>(&archive, 4, 2);
+  Put<uint32_t>(&archive, 8, assets.size());
+  Put<uint64_t>(&archive, 16, index_offset);
+  Put<uint64_t>(&archive, 24, names_offset);
+  ::memcpy(archive.data() + names_offset, names.data(), names.size());
+
+  size_t name_offset = 0;
+  for (size_t i = 0; i < assets.size(); i++) {
+    const TestAsset& asset = assets[i];
+    const size_t entry = index_offset + i * 40;
+    Put<uint64_t>(&archive, entry, PackedAssetResolver::HashName(asset.name));
+    Put<uint32_t>(&archive, entry + 8, name_offset);
+    Put<uint16_t>(&archive, entry + 12, asset.name.size());
+    Put<uint8_t>(&archive, entry + 14, asset.compress ? 1 : 0);
+    Put<uint64_t>(&archive, entry + 16, archive.size());
+    Put<uint64_t>(&archive, entry + 24, data[i].size());
+    Put<uint64_t>(&archive, entry + 32,
+                  asset.claimed_size ? asset.claimed_size
+                                     : asset.contents.size());
+    name_offset += asset.name.size();
+    archive.insert(archive.end(), data[i].begin(), data[i].end());
+    archive.resize((archive.size() + 7) / 8 * 8);
+  }
+  return archive;
+}
+
+static std::unique_ptr<PackedAssetResolver> MakeResolver(
+    std::vector<TestAsset> assets,
+    size_t cache_capacity = PackedAssetResolver::kDefaultCacheCapacity) {
+  return PackedAssetResolver::Create(
+      std::make_shared<fml::DataMapping>(MakeArchive(std::move(assets))),
+      cache_capacity);
+}
+
+static std::string Get(const AssetResolver& resolver, const std::string& name) {
+  auto mapping = resolver.GetAsMapping(name);
+  if (!mapping) {
+    return "<missing>";
+  }
+  return std::string(reinterpret_cast<const char*>(mapping->GetMapping()),
+                     mapping->GetSize());
+}
+
+TEST(PackedAssetResolverTest, ServesStoredAndCompressedAssets) {
+  const std::string large(4000, 'x');
+  auto resolver = MakeResolver({
+      {"AssetManifest.json", "{}"},
+      {"images/a.png", "png bytes"},
+      {"fonts/Roboto.ttf", large, true},
+  });
+  ASSERT_TRUE(resolver);
+  EXPECT_EQ(resolver->GetAssetCount(), 3u);
+
+  EXPECT_EQ(Get(*resolver, "AssetManifest.json"), "{}");
+  EXPECT_EQ(Get(*resolver, "images/a.png"), "png bytes");
+  EXPECT_EQ(Get(*resolver, "fonts/Roboto.ttf"), large);
+  EXPECT_EQ(Get(*resolver, "fonts/Roboto.ttf"), large);
+  EXPECT_EQ(Get(*resolver, "images/b.png"), "<missing>");
+
+  auto stats = resolver->GetCacheStats();
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.cached_bytes, large.size());
+}
+
+TEST(PackedAssetResolverTest, EvictsLeastRecentlyUsedAssets) {
+  auto resolver = MakeResolver(
+      {
+          {"a", std::string(600, 'a'), true},
+          {"b", std::string(600, 'b'), true},
+          {"c", std::string(600, 'c'), true},
+      },
+      1500);
+  ASSERT_TRUE(resolver);
+
+  Get(*resolver, "a");
+  Get(*resolver, "b");
+  Get(*resolver, "a");
+  Get(*resolver, "c");
+  auto stats = resolver->GetCacheStats();
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.cached_bytes, 1200u);
+
+  // "b" was evicted, "a" was not.
+  Get(*resolver, "a");
+  EXPECT_EQ(resolver->GetCacheStats().hits, 2u);
+  EXPECT_EQ(Get(*resolver, "b"), std::string(600, 'b'));
+  EXPECT_EQ(resolver->GetCacheStats().misses, 4u);
+}
+
+TEST(PackedAssetResolverTest, RejectsImplausibleDecompressedSizes) {
+  auto resolver = MakeResolver({
+      {"huge", std::string(1000, 'h'), true, 1ull << 40},
+      {"ratio", std::string(1000, 'r'), true, 100 << 20},
+      {"wrong", std::string(1000, 'w'), true, 999},
+      {"fine", std::string(1000, 'f'), true},
+  });
+  ASSERT_TRUE(resolver);
+  EXPECT_EQ(Get(*resolver, "huge"), "<missing>");
+  EXPECT_EQ(Get(*resolver, "ratio"), "<missing>");
+  EXPECT_EQ(Get(*resolver, "wrong"), "<missing>");
+  EXPECT_EQ(Get(*resolver, "fine"), std::string(1000, 'f'));
+}
+
+TEST(PackedAssetResolverTest, RejectsMalformedArchives) {
+  const std::vector<uint8_t> valid = MakeArchive({{"a", "contents"}});
+  ASSERT_TRUE(PackedAssetResolver::Create(
+      std::make_shared<fml::DataMapping>(valid)));
+
+  std::vector<uint8_t> bad_magic = valid;
+  bad_magic[0] = 'X';
+  EXPECT_FALSE(PackedAssetResolver::Create(
+      std::make_shared<fml::DataMapping>(bad_magic)));
+
+  std::vector<uint8_t> truncated(valid.begin(), valid.end() - 8);
+  EXPECT_FALSE(PackedAssetResolver::Create(
+      std::make_shared<fml::DataMapping>(truncated)));
+
+  std::vector<uint8_t> too_many_entries = valid;
+  Put<uint32_t>(&too_many_entries, 8, 1000);
+  EXPECT_FALSE(PackedAssetResolver::Create(
+      std::make_shared<fml::DataMapping>(too_many_entries)));
+}
+
+}  // namespace testing
+}  // namespace flutter
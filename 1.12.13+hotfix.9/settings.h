@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "flutter/fml/closure.h"
@@ -56,6 +57,15 @@ struct Settings {
 
   Settings(const Settings& other);
 
+  // Moves leave the callbacks and strings of |other| empty instead of copying
+  // them. Share settings that are handed around a lot through a
+  // |SettingsSnapshot| instead.
+  Settings(Settings&& other) = default;
+
+  Settings& operator=(const Settings& other) = default;
+
+  Settings& operator=(Settings&& other) = default;
+
   ~Settings();
 
   // VM settings
@@ -78,6 +88,21 @@ struct Settings {
   // case the primary path to the library can not be loaded.
   std::vector<std::string> application_library_path;
 
+  // Optional manifest mapping snapshot symbol names (for example,
+  // |DartSnapshot::kIsolateDataSymbol|) to the library in which they reside.
+  // These libraries are opened before the ones in |application_library_path|,
+  // so an accurate manifest avoids probing libraries that don't contain the
+  // symbols.
+  std::unordered_map<std::string, std::string> application_library_symbol_paths;
+
+  // When set, the VM and isolate snapshot data are published to, or mapped
+  // from, POSIX shared memory objects whose names start with this prefix. Engine
+  // processes launched from the same bundle then share the physical pages of
+  // the data. The prefix must start with a '/'. Objects published from an
+  // older file or application library are detected and replaced. Data supplied
+  // through callbacks is never shared. Only supported on Linux.
+  std::string snapshot_shared_memory_name;
+
   std::string application_kernel_asset;       // deprecated
   std::string application_kernel_list_asset;  // deprecated
   MappingsCallback application_kernels;
@@ -188,14 +213,21 @@ struct Settings {
   // that the isolate cannot request asynchronously (platform messages can be
   // used for that purpose). This data is held for the lifetime of the shell and
   // is available on isolate restarts in the the shell instance. Due to this,
-  // the buffer must be as small as possible.
+  // the buffer must be as small as possible unless it is backed by a file
+  // mapping. Larger payloads should use a read-only |fml::FileMapping| so that
+  // they are neither copied nor kept dirty.
   std::shared_ptr<const fml::Mapping> persistent_isolate_data;
 
   std::string ToString() const;
 
-  const uint8_t* vm_snapshot_data_ptr;
+  // Snapshot data buffers split out of the application library and owned by
+  // the embedder. These take precedence over all other ways of resolving the
+  // snapshot data. Prefer the |vm_snapshot_data| and |isolate_snapshot_data|
+  // callbacks for file backed data as those mappings can be released once the
+  // VM no longer needs them.
+  const uint8_t* vm_snapshot_data_ptr = nullptr;
 
-  const uint8_t* isolate_snapshot_data_ptr;
+  const uint8_t* isolate_snapshot_data_ptr = nullptr;
 };
 
 }  // namespace flutter
@@ -0,0 +1,46 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/common/settings_snapshot.h"
+
+namespace flutter {
+
+SettingsSnapshot::SettingsSnapshot()
+    : settings_(std::make_shared<Settings>()) {}
+
+SettingsSnapshot::SettingsSnapshot(Settings settings)
+    : settings_(std::make_shared<Settings>(std::move(settings))) {}
+
+SettingsSnapshot::SettingsSnapshot(std::shared_ptr<Settings> settings)
+    : settings_(std::move(settings)) {}
+
+SettingsSnapshot::~SettingsSnapshot() = default;
+
+SettingsSnapshot SettingsSnapshot::With(const Override& override) const {
+  auto settings = std::make_shared<Settings>(*settings_);
+  if (override) {
+    override(*settings);
+  }
+  return SettingsSnapshot(std::move(settings));
+}
+
+SettingsSnapshot SettingsSnapshot::With(
+    const std::vector<Override>& overrides) const {
+  auto settings = std::make_shared<Settings>(*settings_);
+  for (const auto& override : overrides) {
+    if (override) {
+      override(*settings);
+    }
+  }
+  return SettingsSnapshot(std::move(settings));
+}
+
+Settings& SettingsSnapshot::Mutable() {
+  if (IsShared()) {
+    settings_ = std::make_shared<Settings>(*settings_);
+  }
+  return *settings_;
+}
+
+}  // namespace flutter
@@ -0,0 +1,89 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_COMMON_SETTINGS_SNAPSHOT_H_
+#define FLUTTER_COMMON_SETTINGS_SNAPSHOT_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "flutter/common/settings.h"
+
+namespace flutter {
+
+// An immutable, reference counted view of |Settings|. Copying a snapshot only
+// copies a pointer, so settings can be handed to any number of shells and
+// engines without duplicating their strings, vectors and callbacks.
+//
+// Snapshots are changed by deriving a new snapshot with overrides applied, or
+// through |Mutable|, which copies the settings first if they are shared. Either
+// way, other holders of the previous snapshot keep seeing the settings they
+// were given. To wrap callbacks without copying the settings right away, keep
+// the overrides as layers and apply them together with |With|.
+//
+// Code that takes a |const Settings&| accepts a snapshot as is.
+class SettingsSnapshot {
+ public:
+  using Override = std::function<void(Settings&)>;
+
+  // A snapshot of the default settings.
+  SettingsSnapshot();
+
+  explicit SettingsSnapshot(Settings settings);
+
+  SettingsSnapshot(const SettingsSnapshot& other) = default;
+
+  SettingsSnapshot(SettingsSnapshot&& other) = default;
+
+  SettingsSnapshot& operator=(const SettingsSnapshot& other) = default;
+
+  SettingsSnapshot& operator=(SettingsSnapshot&& other) = default;
+
+  ~SettingsSnapshot();
+
+  const Settings& Get() const { return *settings_; }
+
+  const Settings& operator*() const { return *settings_; }
+
+  const Settings* operator->() const { return settings_.get(); }
+
+  operator const Settings&() const { return *settings_; }
+
+  std::shared_ptr<const Settings> GetShared() const { return settings_; }
+
+  // Returns a snapshot of these settings with |field| set to |value|.
+  template <typename T, typename U>
+  SettingsSnapshot With(T Settings::*field, U&& value) const {
+    auto settings = std::make_shared<Settings>(*settings_);
+    (*settings).*field = std::forward<U>(value);
+    return SettingsSnapshot(std::move(settings));
+  }
+
+  // Returns a snapshot of these settings with |override| applied.
+  SettingsSnapshot With(const Override& override) const;
+
+  // Returns a snapshot of these settings with |overrides| applied in order.
+  // The settings are copied once however many overrides there are, so callers
+  // can layer their callbacks on top of shared settings and apply the layers
+  // only when the settings are needed.
+  SettingsSnapshot With(const std::vector<Override>& overrides) const;
+
+  // Returns the settings for modification, copying them first if any other
+  // snapshot shares them. References are invalidated by the next copy of this
+  // snapshot that gets modified.
+  Settings& Mutable();
+
+  // Whether other snapshots share these settings.
+  bool IsShared() const { return settings_.use_count() > 1; }
+
+ private:
+  std::shared_ptr<Settings> settings_;
+
+  explicit SettingsSnapshot(std::shared_ptr<Settings> settings);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_COMMON_SETTINGS_SNAPSHOT_H_
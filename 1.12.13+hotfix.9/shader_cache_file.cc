@@ -0,0 +1,323 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/shader_cache_file.h"
+
+#include <cstring>
+#include <vector>
+
+#include "flutter/fml/file.h"
+#include "flutter/fml/logging.h"
+
+namespace flutter {
+
+constexpr char ShaderCacheFile::kFileName[];
+constexpr size_t ShaderCacheFile::kDefaultHotFrameCount;
+constexpr size_t ShaderCacheFile::kSaveIntervalFrames;
+constexpr uint32_t ShaderCacheFile::kHotFlag;
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'L', 'S', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kAlignment = 8;
+constexpr size_t kPageSize = 4096;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t reserved;
+};
+
+struct Record {
+  uint64_t key_hash;
+  uint64_t offset;
+  uint32_t key_size;
+  uint32_t data_size;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 16, "The header is read in place.");
+static_assert(sizeof(Record) == 32, "Index records are read in place.");
+
+uint64_t HashKey(const SkData& key) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  const uint8_t* bytes = key.bytes();
+  for (size_t i = 0; i < key.size(); i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+size_t AlignUp(size_t value) {
+  return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Wraps a range of |mapping| without copying it. The data keeps the mapping
+// alive.
+sk_sp<SkData> MakeSlice(const std::shared_ptr<const fml::Mapping>& mapping,
+                        size_t offset,
+                        size_t size) {
+  auto* owner = new std::shared_ptr<const fml::Mapping>(mapping);
+  return SkData::MakeWithProc(
+      mapping->GetMapping() + offset, size,
+      [](const void*, void* context) {
+        delete static_cast<std::shared_ptr<const fml::Mapping>*>(context);
+      },
+      owner);
+}
+
+std::mutex process_cache_mutex;
+std::shared_ptr<ShaderCacheFile>* process_cache = nullptr;
+
+}  // namespace
+
+ShaderCacheFile::ShaderCacheFile(std::string directory,
+                                 GrContextOptions::PersistentCache* fallback,
+                                 size_t hot_frame_count)
+    : directory_(std::move(directory)),
+      fallback_(fallback),
+      hot_frame_count_(hot_frame_count) {
+  Open();
+}
+
+ShaderCacheFile::~ShaderCacheFile() = default;
+
+std::shared_ptr<ShaderCacheFile> ShaderCacheFile::GetForProcess() {
+  std::lock_guard<std::mutex> lock(process_cache_mutex);
+  return process_cache ? *process_cache : nullptr;
+}
+
+void ShaderCacheFile::SetForProcess(std::shared_ptr<ShaderCacheFile> cache) {
+  std::lock_guard<std::mutex> lock(process_cache_mutex);
+  if (process_cache == nullptr) {
+    // Never destroyed, the raster threads may outlive static destructors.
+    process_cache = new std::shared_ptr<ShaderCacheFile>();
+  }
+  *process_cache = std::move(cache);
+}
+
+void ShaderCacheFile::Open() {
+  std::shared_ptr<const fml::Mapping> mapping =
+      fml::FileMapping::CreateReadOnly(directory_ + "/" + kFileName);
+  if (!mapping || mapping->GetSize() < sizeof(Header)) {
+    return;
+  }
+
+  const uint8_t* data = mapping->GetMapping();
+  const size_t size = mapping->GetSize();
+  Header header;
+  ::memcpy(&header, data, sizeof(header));
+  if (::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      header.entry_count > (size - sizeof(Header)) / sizeof(Record)) {
+    FML_LOG(WARNING) << "Ignoring invalid shader cache in " << directory_;
+    return;
+  }
+
+  for (uint32_t i = 0; i < header.entry_count; i++) {
+    Record record;
+    ::memcpy(&record, data + sizeof(Header) + i * sizeof(Record),
+             sizeof(record));
+    const uint64_t entry_size =
+        static_cast<uint64_t>(record.key_size) + record.data_size;
+    if (record.offset > size || entry_size > size - record.offset) {
+      FML_LOG(WARNING) << "Ignoring truncated shader cache in " << directory_;
+      entries_.clear();
+      return;
+    }
+    Entry& entry = entries_[record.key_hash];
+    entry.key = MakeSlice(mapping, record.offset, record.key_size);
+    entry.data =
+        MakeSlice(mapping, record.offset + record.key_size, record.data_size);
+    entry.was_hot = (record.flags & kHotFlag) != 0;
+  }
+}
+
+// |GrContextOptions::PersistentCache|
+sk_sp<SkData> ShaderCacheFile::load(const SkData& key) {
+  const uint64_t hash = HashKey(key);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(hash);
+    if (found != entries_.end() && found->second.key->equals(&key)) {
+      stats_.hits++;
+      if (!hot_set_complete_ && !found->second.is_hot) {
+        found->second.is_hot = true;
+        has_unsaved_changes_ = true;
+      }
+      return found->second.data;
+    }
+  }
+
+  sk_sp<SkData> data = fallback_ ? fallback_->load(key) : nullptr;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!data) {
+    stats_.misses++;
+    return nullptr;
+  }
+  stats_.hits++;
+  StoreLocked(hash, SkData::MakeWithCopy(key.data(), key.size()), data);
+  return data;
+}
+
+// |GrContextOptions::PersistentCache|
+void ShaderCacheFile::store(const SkData& key, const SkData& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StoreLocked(HashKey(key), SkData::MakeWithCopy(key.data(), key.size()),
+              SkData::MakeWithCopy(data.data(), data.size()));
+  stats_.stores++;
+}
+
+void ShaderCacheFile::StoreLocked(uint64_t hash,
+                                  sk_sp<SkData> key,
+                                  sk_sp<SkData> data) {
+  Entry& entry = entries_[hash];
+  entry.key = std::move(key);
+  entry.data = std::move(data);
+  entry.was_hot = false;
+  entry.is_hot = entry.is_hot || !hot_set_complete_;
+  has_unsaved_changes_ = true;
+}
+
+bool ShaderCacheFile::DidRasterizeFrame(size_t project_frame_count,
+                                        fml::TimeDelta raster_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (frame_count_ == 0) {
+    stats_.first_frame_raster_time = raster_time;
+  }
+  frame_count_++;
+  if (project_frame_count < hot_frame_count_) {
+    return false;
+  }
+  const bool completes_hot_set = project_frame_count == hot_frame_count_;
+  if (completes_hot_set && !hot_set_complete_) {
+    // The hot flags change even if nothing was stored.
+    hot_set_complete_ = true;
+    has_unsaved_changes_ = true;
+  }
+  if (save_pending_ || !has_unsaved_changes_ ||
+      (!completes_hot_set && project_frame_count % kSaveIntervalFrames != 0)) {
+    return false;
+  }
+  save_pending_ = true;
+  return true;
+}
+
+size_t ShaderCacheFile::PrecompileHotEntries(
+    const PrecompileCallback& callback) {
+  std::vector<std::pair<sk_sp<SkData>, sk_sp<SkData>>> hot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& item : entries_) {
+      if (item.second.was_hot) {
+        hot.emplace_back(item.second.key, item.second.data);
+      }
+    }
+  }
+
+  // Compiling happens without the lock so that the raster thread can keep
+  // loading programs in the meantime.
+  for (const auto& entry : hot) {
+    const SkData& data = *entry.second;
+    volatile uint8_t sink = 0;
+    for (size_t offset = 0; offset < data.size(); offset += kPageSize) {
+      sink = sink + data.bytes()[offset];
+    }
+    if (callback) {
+      callback(*entry.first, data);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.precompiled_entries += hot.size();
+  return hot.size();
+}
+
+bool ShaderCacheFile::Save() {
+  struct SavedEntry {
+    uint64_t hash;
+    sk_sp<SkData> key;
+    sk_sp<SkData> data;
+    bool hot;
+  };
+  std::vector<SavedEntry> saved;
+  {
+    // Only take references under the lock. The entries are immutable, so the
+    // file is built from them after the lock is released.
+    std::lock_guard<std::mutex> lock(mutex_);
+    saved.reserve(entries_.size());
+    for (const auto& item : entries_) {
+      // Before the hot set is complete, keep the one of the previous launch.
+      const bool hot = hot_set_complete_
+                           ? item.second.is_hot
+                           : item.second.was_hot || item.second.is_hot;
+      saved.push_back({item.first, item.second.key, item.second.data, hot});
+    }
+    has_unsaved_changes_ = false;
+  }
+
+  size_t offset = sizeof(Header) + saved.size() * sizeof(Record);
+  std::vector<Record> records;
+  records.reserve(saved.size());
+  for (const SavedEntry& entry : saved) {
+    Record record = {};
+    record.key_hash = entry.hash;
+    record.offset = offset;
+    record.key_size = entry.key->size();
+    record.data_size = entry.data->size();
+    record.flags = entry.hot ? kHotFlag : 0;
+    records.push_back(record);
+    offset = AlignUp(offset + record.key_size + record.data_size);
+  }
+
+  std::vector<uint8_t> buffer(offset);
+  Header header = {};
+  ::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entry_count = records.size();
+  ::memcpy(buffer.data(), &header, sizeof(header));
+  ::memcpy(buffer.data() + sizeof(header), records.data(),
+           records.size() * sizeof(Record));
+  for (size_t i = 0; i < saved.size(); i++) {
+    const Record& record = records[i];
+    ::memcpy(buffer.data() + record.offset, saved[i].key->data(),
+             record.key_size);
+    ::memcpy(buffer.data() + record.offset + record.key_size,
+             saved[i].data->data(), record.data_size);
+  }
+
+  auto directory = fml::OpenDirectory(directory_.c_str(), true,
+                                      fml::FilePermission::kReadWrite);
+  const bool written =
+      directory.is_valid() &&
+      fml::WriteAtomically(directory, kFileName,
+                           fml::DataMapping(std::move(buffer)));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  save_pending_ = false;
+  if (!written) {
+    has_unsaved_changes_ = true;
+  }
+  return written;
+}
+
+ShaderCacheFile::Stats ShaderCacheFile::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  for (const auto& item : entries_) {
+    if (item.second.is_hot) {
+      stats.hot_entries++;
+    }
+  }
+  const size_t lookups = stats.hits + stats.misses;
+  stats.hit_rate =
+      lookups == 0 ? 0.0 : static_cast<double>(stats.hits) / lookups;
+  return stats;
+}
+
+}  // namespace flutter
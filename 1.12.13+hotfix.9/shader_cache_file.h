@@ -0,0 +1,159 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_SHELL_COMMON_SHADER_CACHE_FILE_H_
+#define FLUTTER_SHELL_COMMON_SHADER_CACHE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "flutter/fml/macros.h"
+#include "flutter/fml/mapping.h"
+#include "flutter/fml/time/time_delta.h"
+#include "third_party/skia/include/core/SkData.h"
+#include "third_party/skia/include/gpu/GrContextOptions.h"
+
+namespace flutter {
+
+// A persistent cache of compiled shader programs kept in a single file. The
+// file is mapped read-only when the cache is opened and rewritten as a whole by
+// |Save|, so a launch reads no shader from disk until it is needed and never
+// opens more than one file.
+//
+// When set for the process, this cache takes the place of
+// |PersistentCache::GetCacheForProcess()| as the |fPersistentCache| of the
+// |GrContext|s that the GPU surfaces create. The per-program files written by
+// |PersistentCache| are still read through the fallback cache, and programs
+// found there move into this file, so only one cache is ever written.
+//
+// The programs loaded or stored before any project has rasterized
+// |hot_frame_count| frames are marked as hot when the cache is saved. On the
+// next launch, |PrecompileHotEntries| can warm exactly those programs off the
+// raster thread before the first frame asks for them.
+//
+// File layout (little endian):
+//
+//   Header
+//     char     magic[4]        "FLSC"
+//     uint32_t version         1
+//     uint32_t entry_count
+//     uint32_t reserved
+//   Index, entry_count times
+//     uint64_t key_hash        64-bit FNV-1a of the key
+//     uint64_t offset          of the key, the data follows it
+//     uint32_t key_size
+//     uint32_t data_size
+//     uint32_t flags           see |kHotFlag|
+//     uint32_t reserved
+//   Keys and data, each entry 8 byte aligned
+//
+// All methods may be called from any thread.
+class ShaderCacheFile final : public GrContextOptions::PersistentCache {
+ public:
+  static constexpr char kFileName[] = "flutter_shader_cache.bin";
+  static constexpr size_t kDefaultHotFrameCount = 8;
+  // Once the hot set is complete, newly stored programs are saved at most
+  // once per this many frames of a project.
+  static constexpr size_t kSaveIntervalFrames = 60;
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stores = 0;
+    size_t hot_entries = 0;
+    size_t precompiled_entries = 0;
+    double hit_rate = 0.0;
+    // Zero until the first frame has been rasterized.
+    fml::TimeDelta first_frame_raster_time;
+  };
+
+  using PrecompileCallback =
+      std::function<void(const SkData& key, const SkData& data)>;
+
+  // Opens the cache file in |directory|. A missing or invalid file results in
+  // an empty cache that is written out on the first |Save|. Programs missing
+  // from the file are looked up in |fallback|, if any, which must outlive the
+  // cache.
+  explicit ShaderCacheFile(
+      std::string directory,
+      GrContextOptions::PersistentCache* fallback = nullptr,
+      size_t hot_frame_count = kDefaultHotFrameCount);
+
+  ~ShaderCacheFile() override;
+
+  // The cache that the GPU surfaces of this process hand to their
+  // |GrContext|s. Null unless set.
+  static std::shared_ptr<ShaderCacheFile> GetForProcess();
+
+  static void SetForProcess(std::shared_ptr<ShaderCacheFile> cache);
+
+  // |GrContextOptions::PersistentCache|
+  sk_sp<SkData> load(const SkData& key) override;
+
+  // |GrContextOptions::PersistentCache|
+  void store(const SkData& key, const SkData& data) override;
+
+  // Counts a frame rasterized by a project using the cache, which has now
+  // rasterized |project_frame_count| frames. Each project counts its own
+  // frames. Returns true if the cache has changes that should be saved now:
+  // when the project completes its hot set, and afterwards every
+  // |kSaveIntervalFrames| frames while programs were stored since the last
+  // save. Returns false while a save is pending, so the caller must |Save|
+  // whenever this returns true.
+  bool DidRasterizeFrame(size_t project_frame_count,
+                         fml::TimeDelta raster_time);
+
+  // Faults in the entries that were hot when the cache was last saved and
+  // passes each one to |callback|, if any, to compile it. Blocks until done,
+  // so it should be called on a background thread. Returns the number of
+  // entries visited.
+  size_t PrecompileHotEntries(const PrecompileCallback& callback = nullptr);
+
+  // Writes all entries to the cache file, replacing it atomically. The file is
+  // built and written without holding up |load| and |store|.
+  bool Save();
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr uint32_t kHotFlag = 1 << 0;
+
+  struct Entry {
+    sk_sp<SkData> key;
+    sk_sp<SkData> data;
+    // Hot when the file was opened.
+    bool was_hot = false;
+    // Used before the hot set of this launch was complete.
+    bool is_hot = false;
+  };
+
+  const std::string directory_;
+  GrContextOptions::PersistentCache* const fallback_;
+  const size_t hot_frame_count_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  size_t frame_count_ = 0;
+  bool hot_set_complete_ = false;
+  // Entries or hot flags changed since the file was last written.
+  bool has_unsaved_changes_ = false;
+  bool save_pending_ = false;
+  Stats stats_;
+
+  void Open();
+
+  // Adds or replaces an entry. |mutex_| must be held.
+  void StoreLocked(uint64_t hash, sk_sp<SkData> key, sk_sp<SkData> data);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(ShaderCacheFile);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_SHELL_COMMON_SHADER_CACHE_FILE_H_
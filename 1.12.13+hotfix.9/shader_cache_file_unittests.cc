@@ -0,0 +1,190 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/common/shader_cache_file.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace flutter {
+namespace testing {
+
+static sk_sp<SkData> Data(const std::string& string) {
+  return SkData::MakeWithCopy(string.data(), string.size());
+}
+
+static std::string String(const sk_sp<SkData>& data) {
+  if (!data) {
+    return "<missing>";
+  }
+  return std::string(static_cast<const char*>(data->data()), data->size());
+}
+
+// A directory that is removed with everything in it at the end of the test.
+class ScopedTempDirectory {
+ public:
+  ScopedTempDirectory() {
+    char path[] = "/tmp/shader_cache_file_unittests.XXXXXX";
+    path_ = ::mkdtemp(path);
+  }
+
+  ~ScopedTempDirectory() {
+    ::unlink((path_ + "/" + ShaderCacheFile::kFileName).c_str());
+    ::rmdir(path_.c_str());
+  }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+// Stands in for the per-program files of |PersistentCache|.
+class FakeFallbackCache : public GrContextOptions::PersistentCache {
+ public:
+  std::map<std::string, std::string> programs;
+  size_t stores = 0;
+
+  sk_sp<SkData> load(const SkData& key) override {
+    auto found = programs.find(
+        std::string(static_cast<const char*>(key.data()), key.size()));
+    return found == programs.end() ? nullptr : Data(found->second);
+  }
+
+  void store(const SkData& key, const SkData& data) override { stores++; }
+};
+
+static void RasterizeFrames(ShaderCacheFile& cache,
+                            size_t* project_frame_count,
+                            size_t frames,
+                            std::vector<size_t>* save_frames) {
+  for (size_t i = 0; i < frames; i++) {
+    ++*project_frame_count;
+    if (cache.DidRasterizeFrame(*project_frame_count,
+                                fml::TimeDelta::FromMilliseconds(4))) {
+      save_frames->push_back(*project_frame_count);
+      EXPECT_TRUE(cache.Save());
+    }
+  }
+}
+
+TEST(ShaderCacheFileTest, PersistsProgramsAndHotFlags) {
+  ScopedTempDirectory directory;
+  {
+    ShaderCacheFile cache(directory.path(), nullptr, 2);
+    EXPECT_EQ(String(cache.load(*Data("a"))), "<missing>");
+    cache.store(*Data("a"), *Data("program a"));
+    size_t frames = 0;
+    std::vector<size_t> saves;
+    RasterizeFrames(cache, &frames, 2, &saves);
+    // Stored after the hot set was complete.
+    cache.store(*Data("b"), *Data("program b"));
+    EXPECT_TRUE(cache.Save());
+  }
+
+  ShaderCacheFile cache(directory.path(), nullptr, 2);
+  EXPECT_EQ(String(cache.load(*Data("a"))), "program a");
+  EXPECT_EQ(String(cache.load(*Data("b"))), "program b");
+  EXPECT_EQ(String(cache.load(*Data("c"))), "<missing>");
+
+  std::vector<std::string> hot;
+  EXPECT_EQ(cache.PrecompileHotEntries(
+                [&hot](const SkData& key, const SkData& data) {
+                  hot.push_back(std::string(
+                      static_cast<const char*>(key.data()), key.size()));
+                }),
+            1u);
+  EXPECT_EQ(hot, std::vector<std::string>{"a"});
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 2u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.precompiled_entries, 1u);
+}
+
+TEST(ShaderCacheFileTest, SavesAgainWhenLaterFramesStorePrograms) {
+  ScopedTempDirectory directory;
+  ShaderCacheFile cache(directory.path(), nullptr, 8);
+  size_t frames = 0;
+  std::vector<size_t> saves;
+
+  cache.store(*Data("a"), *Data("program a"));
+  RasterizeFrames(cache, &frames, 100, &saves);
+  EXPECT_EQ(saves, std::vector<size_t>{8});
+
+  // Nothing new is stored, so nothing is saved.
+  RasterizeFrames(cache, &frames, 100, &saves);
+  EXPECT_EQ(saves, std::vector<size_t>{8});
+
+  // A program stored later is saved at the next interval.
+  cache.store(*Data("b"), *Data("program b"));
+  RasterizeFrames(cache, &frames, 100, &saves);
+  EXPECT_EQ(saves, (std::vector<size_t>{8, 240}));
+
+  ShaderCacheFile reopened(directory.path());
+  EXPECT_EQ(String(reopened.load(*Data("b"))), "program b");
+}
+
+TEST(ShaderCacheFileTest, CountsFramesPerProject) {
+  ScopedTempDirectory directory;
+  ShaderCacheFile cache(directory.path(), nullptr, 8);
+  size_t first_project_frames = 0;
+  size_t second_project_frames = 0;
+  std::vector<size_t> first_saves;
+  std::vector<size_t> second_saves;
+
+  cache.store(*Data("a"), *Data("program a"));
+  RasterizeFrames(cache, &first_project_frames, 10, &first_saves);
+  EXPECT_EQ(first_saves, std::vector<size_t>{8});
+
+  // The programs of a project started later are saved once it completes its
+  // own hot set, even though the process has rasterized more frames.
+  cache.store(*Data("b"), *Data("program b"));
+  RasterizeFrames(cache, &second_project_frames, 10, &second_saves);
+  EXPECT_EQ(second_saves, std::vector<size_t>{8});
+}
+
+TEST(ShaderCacheFileTest, DoesNotSaveWhileASaveIsPending) {
+  ScopedTempDirectory directory;
+  ShaderCacheFile cache(directory.path(), nullptr, 1);
+  cache.store(*Data("a"), *Data("program a"));
+  EXPECT_TRUE(cache.DidRasterizeFrame(1, fml::TimeDelta::FromMilliseconds(4)));
+
+  // Another project completes its hot set before the save ran.
+  cache.store(*Data("b"), *Data("program b"));
+  EXPECT_FALSE(cache.DidRasterizeFrame(1, fml::TimeDelta::FromMilliseconds(4)));
+  EXPECT_TRUE(cache.Save());
+
+  cache.store(*Data("c"), *Data("program c"));
+  EXPECT_TRUE(cache.DidRasterizeFrame(1, fml::TimeDelta::FromMilliseconds(4)));
+  EXPECT_TRUE(cache.Save());
+}
+
+TEST(ShaderCacheFileTest, MovesProgramsOfTheFallbackIntoTheFile) {
+  ScopedTempDirectory directory;
+  FakeFallbackCache fallback;
+  fallback.programs["a"] = "program a";
+  {
+    ShaderCacheFile cache(directory.path(), &fallback);
+    EXPECT_EQ(String(cache.load(*Data("a"))), "program a");
+    EXPECT_EQ(String(cache.load(*Data("b"))), "<missing>");
+    cache.store(*Data("b"), *Data("program b"));
+    EXPECT_EQ(fallback.stores, 0u);
+    EXPECT_TRUE(cache.Save());
+  }
+
+  fallback.programs.clear();
+  ShaderCacheFile cache(directory.path(), &fallback);
+  EXPECT_EQ(String(cache.load(*Data("a"))), "program a");
+  EXPECT_EQ(String(cache.load(*Data("b"))), "program b");
+}
+
+}  // namespace testing
+}  // namespace flutter
@@ -0,0 +1,232 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/shared_memory_mapping.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "flutter/fml/eintr_wrapper.h"
+#include "flutter/fml/logging.h"
+#include "flutter/fml/unique_fd.h"
+
+namespace fml {
+
+namespace {
+
+constexpr uint64_t kHeaderMagic = 0x464c5453484d454dull;  // "FLTSHMEM"
+
+// A publisher that has not finished by then is considered to have stalled.
+constexpr time_t kPublishTimeoutSeconds = 10;
+
+enum : uint32_t {
+  kStateWriting = 0,
+  kStateReady = 1,
+};
+
+// Precedes the data in the shared memory object. The data that follows is
+// suitably aligned for Dart snapshots.
+struct alignas(64) Header {
+  uint64_t magic;
+  uint64_t size;
+  uint64_t source_id;
+  uint32_t state;
+  int32_t publisher_pid;
+};
+
+bool IsValidName(const std::string& name) {
+  return name.size() > 1 && name[0] == '/' &&
+         name.find('/', 1) == std::string::npos;
+}
+
+uint8_t* MapFD(const fml::UniqueFD& fd, size_t size, int protection) {
+  void* mapping = ::mmap(nullptr, size, protection, MAP_SHARED, fd.get(), 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  return static_cast<uint8_t*>(mapping);
+}
+
+// Whether an object that is still being written to has been abandoned by its
+// publisher.
+bool IsAbandoned(const struct stat& info, pid_t publisher_pid) {
+  if (publisher_pid > 0 && ::kill(publisher_pid, 0) != 0 && errno == ESRCH) {
+    return true;
+  }
+  return ::time(nullptr) - info.st_mtime > kPublishTimeoutSeconds;
+}
+
+}  // namespace
+
+std::unique_ptr<SharedMemoryMapping> SharedMemoryMapping::CreateOrOpen(
+    const std::string& name,
+    uint64_t source_id,
+    const SourceCallback& source) {
+  if (!IsValidName(name) || !source) {
+    return nullptr;
+  }
+
+  fml::UniqueFD fd;
+  // A stale object is replaced at most once, so that processes publishing
+  // from different sources under the same name cannot keep unlinking each
+  // other's objects.
+  for (size_t attempt = 0; attempt < 2; attempt++) {
+    fd.reset(::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0444));
+    if (fd.is_valid()) {
+      break;
+    }
+    if (errno != EEXIST) {
+      return nullptr;
+    }
+    // Another process has already published, or is publishing, the data.
+    std::unique_ptr<SharedMemoryMapping> mapping;
+    switch (TryOpen(name, source_id, &mapping)) {
+      case OpenResult::kReady:
+        return mapping;
+      case OpenResult::kBusy:
+        return nullptr;
+      case OpenResult::kStale:
+        FML_DLOG(INFO) << "Replacing stale shared memory object " << name;
+        Unlink(name);
+        break;
+    }
+  }
+  if (!fd.is_valid()) {
+    return nullptr;
+  }
+
+  auto data = source();
+  if (!data || data->GetMapping() == nullptr || data->GetSize() == 0) {
+    // Symbol mappings don't know their size and can't be published.
+    Unlink(name);
+    return nullptr;
+  }
+
+  const size_t mapped_size = sizeof(Header) + data->GetSize();
+  if (HANDLE_EINTR(::ftruncate(fd.get(), mapped_size)) != 0) {
+    FML_DLOG(ERROR) << "Could not size shared memory object " << name;
+    Unlink(name);
+    return nullptr;
+  }
+
+  auto writable = MapFD(fd, mapped_size, PROT_READ | PROT_WRITE);
+  if (writable == nullptr) {
+    Unlink(name);
+    return nullptr;
+  }
+
+  auto header = reinterpret_cast<Header*>(writable);
+  header->magic = kHeaderMagic;
+  header->size = data->GetSize();
+  header->source_id = source_id;
+  __atomic_store_n(&header->publisher_pid, ::getpid(), __ATOMIC_RELAXED);
+  ::memcpy(writable + sizeof(Header), data->GetMapping(), data->GetSize());
+  // Readers in other processes may map the object at any time and must not
+  // see the data before it has been written in full.
+  __atomic_store_n(&header->state, kStateReady, __ATOMIC_RELEASE);
+  ::munmap(writable, mapped_size);
+
+  auto readable = MapFD(fd, mapped_size, PROT_READ);
+  if (readable == nullptr) {
+    return nullptr;
+  }
+
+  return std::unique_ptr<SharedMemoryMapping>(
+      new SharedMemoryMapping(readable, mapped_size));
+}
+
+std::unique_ptr<SharedMemoryMapping> SharedMemoryMapping::Open(
+    const std::string& name,
+    uint64_t source_id) {
+  std::unique_ptr<SharedMemoryMapping> mapping;
+  if (TryOpen(name, source_id, &mapping) != OpenResult::kReady) {
+    return nullptr;
+  }
+  return mapping;
+}
+
+SharedMemoryMapping::OpenResult SharedMemoryMapping::TryOpen(
+    const std::string& name,
+    uint64_t source_id,
+    std::unique_ptr<SharedMemoryMapping>* mapping) {
+  if (!IsValidName(name)) {
+    return OpenResult::kBusy;
+  }
+
+  fml::UniqueFD fd(::shm_open(name.c_str(), O_RDONLY, 0));
+  if (!fd.is_valid()) {
+    return OpenResult::kBusy;
+  }
+
+  struct stat info = {};
+  if (::fstat(fd.get(), &info) != 0) {
+    return OpenResult::kBusy;
+  }
+  if (static_cast<size_t>(info.st_size) <= sizeof(Header)) {
+    // The publisher has not sized the object yet.
+    return IsAbandoned(info, 0) ? OpenResult::kStale : OpenResult::kBusy;
+  }
+
+  const size_t mapped_size = info.st_size;
+  auto readable = MapFD(fd, mapped_size, PROT_READ);
+  if (readable == nullptr) {
+    return OpenResult::kBusy;
+  }
+
+  auto header = reinterpret_cast<const Header*>(readable);
+  OpenResult result = OpenResult::kReady;
+  if (__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != kStateReady) {
+    const pid_t publisher_pid =
+        __atomic_load_n(&header->publisher_pid, __ATOMIC_RELAXED);
+    result = IsAbandoned(info, publisher_pid) ? OpenResult::kStale
+                                              : OpenResult::kBusy;
+  } else if (header->magic != kHeaderMagic ||
+             header->size != mapped_size - sizeof(Header) ||
+             header->source_id != source_id) {
+    result = OpenResult::kStale;
+  }
+
+  if (result != OpenResult::kReady) {
+    ::munmap(readable, mapped_size);
+    return result;
+  }
+  mapping->reset(new SharedMemoryMapping(readable, mapped_size));
+  return OpenResult::kReady;
+}
+
+bool SharedMemoryMapping::Unlink(const std::string& name) {
+  return IsValidName(name) && ::shm_unlink(name.c_str()) == 0;
+}
+
+SharedMemoryMapping::SharedMemoryMapping(uint8_t* base, size_t mapped_size)
+    : base_(base), mapped_size_(mapped_size) {}
+
+SharedMemoryMapping::~SharedMemoryMapping() {
+  if (base_ != nullptr) {
+    ::munmap(base_, mapped_size_);
+  }
+}
+
+size_t SharedMemoryMapping::GetSize() const {
+  return mapped_size_ - sizeof(Header);
+}
+
+const uint8_t* SharedMemoryMapping::GetMapping() const {
+  return base_ + sizeof(Header);
+}
+
+bool SharedMemoryMapping::ReleaseResidentPages() const {
+  // The pages are owned by the shared memory object and only unmapped from
+  // this process.
+  return ::madvise(base_, mapped_size_, MADV_DONTNEED) == 0;
+}
+
+}  // namespace fml
@@ -0,0 +1,85 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_SHARED_MEMORY_MAPPING_H_
+#define FLUTTER_FML_SHARED_MEMORY_MAPPING_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "flutter/fml/build_config.h"
+#include "flutter/fml/macros.h"
+#include "flutter/fml/mapping.h"
+
+namespace fml {
+
+// A read-only mapping of a named POSIX shared memory object. Processes that map
+// the same name share the physical pages of the data instead of each keeping a
+// private copy of it.
+//
+// The shared memory objects outlive the processes that created them. Each one
+// records the |source_id| it was published from, a value that changes whenever
+// the data does (for example, a hash of the identity of the file the data was
+// read from). Objects published from a different source, and objects whose
+// publisher died or stalled before finishing, are unlinked and published
+// again.
+class SharedMemoryMapping final : public Mapping {
+ public:
+  using SourceCallback = std::function<std::shared_ptr<const Mapping>(void)>;
+
+  // Maps the shared memory object with the given name. If no process has
+  // published it from |source_id| yet, the contents are obtained from |source|
+  // and published under |name| first. Returns nullptr if the data could not be
+  // shared, in which case callers should fall back to a private mapping.
+  static std::unique_ptr<SharedMemoryMapping> CreateOrOpen(
+      const std::string& name,
+      uint64_t source_id,
+      const SourceCallback& source);
+
+  // Maps a shared memory object that has been published from |source_id|.
+  // Returns nullptr if there is no such object, if it is still being written
+  // to or if it was published from another source.
+  static std::unique_ptr<SharedMemoryMapping> Open(const std::string& name,
+                                                   uint64_t source_id);
+
+  static bool Unlink(const std::string& name);
+
+  ~SharedMemoryMapping() override;
+
+  // |Mapping|
+  size_t GetSize() const override;
+
+  // |Mapping|
+  const uint8_t* GetMapping() const override;
+
+  // |Mapping|
+  bool ReleaseResidentPages() const override;
+
+ private:
+  uint8_t* base_ = nullptr;
+  size_t mapped_size_ = 0;
+
+  enum class OpenResult {
+    kReady,
+    // A live process is still publishing the object.
+    kBusy,
+    // The object was published from another source or its publisher never
+    // finished. It should be unlinked and published again.
+    kStale,
+  };
+
+  SharedMemoryMapping(uint8_t* base, size_t mapped_size);
+
+  static OpenResult TryOpen(const std::string& name,
+                            uint64_t source_id,
+                            std::unique_ptr<SharedMemoryMapping>* mapping);
+
+  FML_DISALLOW_COPY_AND_ASSIGN(SharedMemoryMapping);
+};
+
+}  // namespace fml
+
+#endif  // FLUTTER_FML_SHARED_MEMORY_MAPPING_H_
@@ -0,0 +1,151 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/shared_memory_mapping.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace fml {
+namespace testing {
+
+// A name that is unique to the test process, removed before and after each
+// test.
+class ScopedSharedMemoryName {
+ public:
+  explicit ScopedSharedMemoryName(const char* test)
+      : name_("/flutter_shm_" + std::string(test) + "_" +
+              std::to_string(::getpid())) {
+    SharedMemoryMapping::Unlink(name_);
+  }
+
+  ~ScopedSharedMemoryName() { SharedMemoryMapping::Unlink(name_); }
+
+  const std::string& name() const { return name_; }
+
+ private:
+  std::string name_;
+};
+
+static SharedMemoryMapping::SourceCallback MakeSource(const char* contents,
+                                                      int* calls) {
+  return [contents, calls]() -> std::shared_ptr<const Mapping> {
+    (*calls)++;
+    return std::make_shared<NonOwnedMapping>(
+        reinterpret_cast<const uint8_t*>(contents), ::strlen(contents));
+  };
+}
+
+static std::string Contents(const Mapping& mapping) {
+  return std::string(reinterpret_cast<const char*>(mapping.GetMapping()),
+                     mapping.GetSize());
+}
+
+// Runs |child| in a forked process and returns its exit status.
+template <typename Child>
+static int RunInChildProcess(const Child& child) {
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    ::_exit(child());
+  }
+  int status = 0;
+  EXPECT_EQ(::waitpid(pid, &status, 0), pid);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+TEST(SharedMemoryMappingTest, OpensWhatAnotherProcessPublished) {
+  ScopedSharedMemoryName name("publish");
+  int calls = 0;
+  ASSERT_EQ(RunInChildProcess([&]() {
+              auto published = SharedMemoryMapping::CreateOrOpen(
+                  name.name(), 1, MakeSource("snapshot", &calls));
+              return published && calls == 1 ? 0 : 1;
+            }),
+            0);
+
+  // The publisher is gone, but the object outlives it.
+  auto opened = SharedMemoryMapping::Open(name.name(), 1);
+  ASSERT_TRUE(opened);
+  EXPECT_EQ(Contents(*opened), "snapshot");
+
+  auto created = SharedMemoryMapping::CreateOrOpen(
+      name.name(), 1, MakeSource("snapshot", &calls));
+  ASSERT_TRUE(created);
+  EXPECT_EQ(calls, 0);
+  EXPECT_EQ(Contents(*created), "snapshot");
+}
+
+TEST(SharedMemoryMappingTest, RepublishesObjectsOfAnotherSource) {
+  ScopedSharedMemoryName name("stale");
+  int calls = 0;
+  auto old_version = SharedMemoryMapping::CreateOrOpen(
+      name.name(), 1, MakeSource("version 1", &calls));
+  ASSERT_TRUE(old_version);
+
+  EXPECT_FALSE(SharedMemoryMapping::Open(name.name(), 2));
+  auto new_version = SharedMemoryMapping::CreateOrOpen(
+      name.name(), 2, MakeSource("version 2", &calls));
+  ASSERT_TRUE(new_version);
+  EXPECT_EQ(calls, 2);
+  EXPECT_EQ(Contents(*new_version), "version 2");
+
+  // Existing mappings keep the data they were given.
+  EXPECT_EQ(Contents(*old_version), "version 1");
+}
+
+// Leaves an object that looks like a publisher in process |publisher_pid|
+// was interrupted while writing it. See |Header| in shared_memory_mapping.cc.
+static void CreateUnfinishedObject(const std::string& name,
+                                   int32_t publisher_pid) {
+  const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0444);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(::ftruncate(fd, 128), 0);
+  void* header =
+      ::mmap(nullptr, 128, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ASSERT_NE(header, MAP_FAILED);
+  // The state stays |kStateWriting|.
+  ::memcpy(static_cast<uint8_t*>(header) + 28, &publisher_pid,
+           sizeof(publisher_pid));
+  ::munmap(header, 128);
+  ::close(fd);
+}
+
+TEST(SharedMemoryMappingTest, RecoversFromAPublisherThatDied) {
+  ScopedSharedMemoryName name("dead");
+  // The child exits before it finishes, and is reaped, so its pid is dead.
+  const pid_t publisher = ::fork();
+  if (publisher == 0) {
+    ::_exit(0);
+  }
+  ASSERT_EQ(::waitpid(publisher, nullptr, 0), publisher);
+  CreateUnfinishedObject(name.name(), publisher);
+
+  EXPECT_FALSE(SharedMemoryMapping::Open(name.name(), 1));
+  int calls = 0;
+  auto mapping = SharedMemoryMapping::CreateOrOpen(
+      name.name(), 1, MakeSource("recovered", &calls));
+  ASSERT_TRUE(mapping);
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(Contents(*mapping), "recovered");
+}
+
+TEST(SharedMemoryMappingTest, WaitsForAPublisherThatIsAlive) {
+  ScopedSharedMemoryName name("busy");
+  CreateUnfinishedObject(name.name(), ::getpid());
+
+  int calls = 0;
+  EXPECT_FALSE(SharedMemoryMapping::CreateOrOpen(name.name(), 1,
+                                                 MakeSource("busy", &calls)));
+  EXPECT_EQ(calls, 0);
+}
+
+}  // namespace testing
+}  // namespace fml
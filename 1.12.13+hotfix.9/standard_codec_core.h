@@ -0,0 +1,523 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_CORE_H_
+#define FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_CORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+#include <memory>
+
+#include "flutter/shell/platform/common/cpp/standard_codec_utf.h"
+
+namespace flutter {
+namespace codec {
+
+// A portable implementation of the wire format of the standard message codec,
+// shared by the platform specific codecs (for example, FlutterStandardWriter
+// and FlutterStandardReader on Darwin).
+//
+// Values are written in host byte order and aligned relative to the start of
+// the message, exactly like the Dart side of the codec does.
+
+enum class StandardCodecType : uint8_t {
+  kNull = 0,
+  kTrue = 1,
+  kFalse = 2,
+  kInt32 = 3,
+  kInt64 = 4,
+  kLargeInt = 5,
+  kFloat64 = 6,
+  kString = 7,
+  kUInt8Data = 8,
+  kInt32Data = 9,
+  kInt64Data = 10,
+  kFloat64Data = 11,
+  kList = 12,
+  kMap = 13,
+};
+
+// A borrowed view of a sequence of elements inside a message.
+template <typename T>
+struct Span {
+  const T* data = nullptr;
+  size_t size = 0;
+};
+
+// Encodes values into a single contiguous buffer.
+//
+// Space is bump allocated from the buffer, which grows geometrically. Calling
+// |Reset| keeps the buffer around, so a writer reused for every message of a
+// channel stops allocating once it has seen the largest message.
+class StandardWriter {
+ public:
+  explicit StandardWriter(size_t initial_capacity = 256)
+      : initial_capacity_(initial_capacity > 0 ? initial_capacity : 1),
+        capacity_(initial_capacity_) {}
+
+  StandardWriter(const StandardWriter&) = delete;
+  StandardWriter& operator=(const StandardWriter&) = delete;
+
+  // Discards the written bytes but keeps the buffer for the next message.
+  void Reset() { size_ = 0; }
+
+  const uint8_t* data() const { return buffer_.get(); }
+
+  size_t size() const { return size_; }
+
+  // The total number of bytes this writer has allocated over its lifetime.
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  void WriteByte(uint8_t value) { *Allocate(1) = value; }
+
+  void WriteBytes(const void* bytes, size_t length) {
+    if (length > 0) {
+      ::memcpy(Allocate(length), bytes, length);
+    }
+  }
+
+  void WriteSize(uint32_t size) {
+    if (size < 254) {
+      WriteByte(static_cast<uint8_t>(size));
+    } else if (size <= 0xffff) {
+      WriteByte(254);
+      uint16_t value = static_cast<uint16_t>(size);
+      WriteBytes(&value, sizeof(value));
+    } else {
+      WriteByte(255);
+      WriteBytes(&size, sizeof(size));
+    }
+  }
+
+  void WriteAlignment(uint8_t alignment) {
+    size_t padding = (alignment - size_ % alignment) % alignment;
+    if (padding > 0) {
+      ::memset(Allocate(padding), 0, padding);
+    }
+  }
+
+  void WriteNull() { WriteType(StandardCodecType::kNull); }
+
+  void WriteBool(bool value) {
+    WriteType(value ? StandardCodecType::kTrue : StandardCodecType::kFalse);
+  }
+
+  void WriteInt32(int32_t value) {
+    WriteType(StandardCodecType::kInt32);
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteInt64(int64_t value) {
+    WriteType(StandardCodecType::kInt64);
+    WriteBytes(&value, sizeof(value));
+  }
+
+  // Writes the smallest integer type that can hold the value, like the
+  // platform codecs do for integral numbers.
+  void WriteInteger(int64_t value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+      WriteInt32(static_cast<int32_t>(value));
+    } else {
+      WriteInt64(value);
+    }
+  }
+
+  void WriteDouble(double value) {
+    WriteType(StandardCodecType::kFloat64);
+    WriteAlignment(8);
+    WriteBytes(&value, sizeof(value));
+  }
+
+  // |hex_digits| is the hexadecimal representation of the integer.
+  void WriteLargeInt(const char* hex_digits, size_t length) {
+    WriteType(StandardCodecType::kLargeInt);
+    WriteUTF8(hex_digits, length);
+  }
+
+  void WriteString(const char* utf8, size_t length) {
+    WriteType(StandardCodecType::kString);
+    WriteUTF8(utf8, length);
+  }
+
+  // Transcodes |utf16| straight into the message, without an intermediate
+  // UTF-8 copy.
+  void WriteStringUTF16(const char16_t* utf16, size_t length) {
+    WriteType(StandardCodecType::kString);
+    size_t utf8_length = UTF8LengthOfUTF16(utf16, length);
+    WriteSize(static_cast<uint32_t>(utf8_length));
+    if (utf8_length > 0) {
+      ConvertUTF16ToUTF8(utf16, length,
+                         reinterpret_cast<char*>(Allocate(utf8_length)));
+    }
+  }
+
+  void WriteUTF8(const char* utf8, size_t length) {
+    WriteSize(static_cast<uint32_t>(length));
+    WriteBytes(utf8, length);
+  }
+
+  void WriteUInt8Data(const uint8_t* data, size_t count) {
+    WriteTypedData(StandardCodecType::kUInt8Data, data, count, 1);
+  }
+
+  void WriteInt32Data(const int32_t* data, size_t count) {
+    WriteTypedData(StandardCodecType::kInt32Data, data, count, 4);
+  }
+
+  void WriteInt64Data(const int64_t* data, size_t count) {
+    WriteTypedData(StandardCodecType::kInt64Data, data, count, 8);
+  }
+
+  void WriteFloat64Data(const double* data, size_t count) {
+    WriteTypedData(StandardCodecType::kFloat64Data, data, count, 8);
+  }
+
+  // Reserve room for typed data whose elements are then written in place,
+  // instead of being copied from a separate array. The elements are aligned to
+  // their size. The returned pointer is only valid until the next write.
+  uint8_t* ReserveUInt8Data(size_t count) {
+    return ReserveTypedData(StandardCodecType::kUInt8Data, count, 1);
+  }
+
+  int32_t* ReserveInt32Data(size_t count) {
+    return reinterpret_cast<int32_t*>(
+        ReserveTypedData(StandardCodecType::kInt32Data, count, 4));
+  }
+
+  int64_t* ReserveInt64Data(size_t count) {
+    return reinterpret_cast<int64_t*>(
+        ReserveTypedData(StandardCodecType::kInt64Data, count, 8));
+  }
+
+  double* ReserveFloat64Data(size_t count) {
+    return reinterpret_cast<double*>(
+        ReserveTypedData(StandardCodecType::kFloat64Data, count, 8));
+  }
+
+  // Transfers ownership of the encoded message to the caller so that it can
+  // be sent without a copy. The writer allocates a new buffer, starting again
+  // from the initial capacity, for the next message.
+  std::unique_ptr<uint8_t[]> Release(size_t* size) {
+    *size = size_;
+    size_ = 0;
+    capacity_ = initial_capacity_;
+    return std::move(buffer_);
+  }
+
+  // Must be followed by |count| values.
+  void WriteListHeader(size_t count) {
+    WriteType(StandardCodecType::kList);
+    WriteSize(static_cast<uint32_t>(count));
+  }
+
+  // Must be followed by |count| key and value pairs.
+  void WriteMapHeader(size_t count) {
+    WriteType(StandardCodecType::kMap);
+    WriteSize(static_cast<uint32_t>(count));
+  }
+
+ private:
+  const size_t initial_capacity_;
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+  size_t bytes_allocated_ = 0;
+
+  void WriteType(StandardCodecType type) {
+    WriteByte(static_cast<uint8_t>(type));
+  }
+
+  void WriteTypedData(StandardCodecType type,
+                      const void* data,
+                      size_t count,
+                      uint8_t element_size) {
+    uint8_t* elements = ReserveTypedData(type, count, element_size);
+    if (count > 0) {
+      ::memcpy(elements, data, count * element_size);
+    }
+  }
+
+  // Elements are aligned relative to the start of the message, whose buffer
+  // comes from operator new[] and is aligned for all fundamental types. So the
+  // elements are aligned in memory too, and readers can view them in place.
+  uint8_t* ReserveTypedData(StandardCodecType type,
+                            size_t count,
+                            uint8_t element_size) {
+    WriteType(type);
+    WriteSize(static_cast<uint32_t>(count));
+    if (element_size > 1) {
+      WriteAlignment(element_size);
+    }
+    return Allocate(count * element_size);
+  }
+
+  uint8_t* Allocate(size_t length) {
+    if (!buffer_ || size_ + length > capacity_) {
+      Grow(size_ + length);
+    }
+    uint8_t* allocation = buffer_.get() + size_;
+    size_ += length;
+    return allocation;
+  }
+
+  void Grow(size_t required) {
+    size_t capacity = capacity_;
+    while (capacity < required) {
+      capacity *= 2;
+    }
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[capacity]);
+    if (size_ > 0) {
+      ::memcpy(buffer.get(), buffer_.get(), size_);
+    }
+    buffer_ = std::move(buffer);
+    capacity_ = capacity;
+    bytes_allocated_ += capacity;
+  }
+};
+
+// A value decoded from a message. Scalars are decoded in full. Strings, large
+// integers and typed data refer to the message buffer, which must outlive the
+// value. For lists and maps only the element count is decoded. The elements
+// (key and value pairs for maps) follow and are read with further calls to
+// |StandardReader::ReadValue|.
+struct StandardValue {
+  StandardCodecType type = StandardCodecType::kNull;
+  bool bool_value = false;
+  int64_t int_value = 0;
+  double double_value = 0.0;
+  // The payload of strings, large integers and typed data.
+  const uint8_t* data = nullptr;
+  // The length in bytes of strings and large integers, the element count of
+  // typed data, lists and maps.
+  size_t count = 0;
+};
+
+template <typename T>
+struct StandardTypedDataTraits;
+
+template <>
+struct StandardTypedDataTraits<uint8_t> {
+  static constexpr StandardCodecType kType = StandardCodecType::kUInt8Data;
+};
+
+template <>
+struct StandardTypedDataTraits<int32_t> {
+  static constexpr StandardCodecType kType = StandardCodecType::kInt32Data;
+};
+
+template <>
+struct StandardTypedDataTraits<int64_t> {
+  static constexpr StandardCodecType kType = StandardCodecType::kInt64Data;
+};
+
+template <>
+struct StandardTypedDataTraits<double> {
+  static constexpr StandardCodecType kType = StandardCodecType::kFloat64Data;
+};
+
+// Views the elements of a typed data value in place. Returns false if the
+// value holds a different type or if the elements are not aligned in memory,
+// which only happens when the message buffer itself is misaligned. Callers
+// must copy the elements (|StandardValue::data| and |count|) in that case.
+template <typename T>
+bool GetTypedData(const StandardValue& value, Span<T>* elements) {
+  if (value.type != StandardTypedDataTraits<T>::kType) {
+    return false;
+  }
+  if (reinterpret_cast<uintptr_t>(value.data) % alignof(T) != 0) {
+    return false;
+  }
+  elements->data = reinterpret_cast<const T*>(value.data);
+  elements->size = value.count;
+  return true;
+}
+
+// Decodes values from a message without copying them.
+//
+// All methods return false, and leave the reader in an unspecified state, if
+// the message is malformed or truncated.
+class StandardReader {
+ public:
+  StandardReader(const uint8_t* data, size_t size)
+      : data_(data), size_(data ? size : 0) {}
+
+  bool HasMore() const { return position_ < size_; }
+
+  size_t position() const { return position_; }
+
+  bool ReadByte(uint8_t* value) {
+    if (position_ >= size_) {
+      return false;
+    }
+    *value = data_[position_++];
+    return true;
+  }
+
+  bool ReadBytes(void* destination, size_t length) {
+    const uint8_t* bytes = nullptr;
+    if (!Borrow(length, &bytes)) {
+      return false;
+    }
+    ::memcpy(destination, bytes, length);
+    return true;
+  }
+
+  bool ReadSize(uint32_t* size) {
+    uint8_t byte = 0;
+    if (!ReadByte(&byte)) {
+      return false;
+    }
+    if (byte < 254) {
+      *size = byte;
+      return true;
+    }
+    if (byte == 254) {
+      uint16_t value = 0;
+      if (!ReadBytes(&value, sizeof(value))) {
+        return false;
+      }
+      *size = value;
+      return true;
+    }
+    return ReadBytes(size, sizeof(*size));
+  }
+
+  bool ReadAlignment(uint8_t alignment) {
+    size_t padding = (alignment - position_ % alignment) % alignment;
+    if (padding > size_ - position_) {
+      return false;
+    }
+    position_ += padding;
+    return true;
+  }
+
+  bool ReadUTF8(Span<char>* string) {
+    uint32_t length = 0;
+    const uint8_t* bytes = nullptr;
+    if (!ReadSize(&length) || !Borrow(length, &bytes)) {
+      return false;
+    }
+    string->data = reinterpret_cast<const char*>(bytes);
+    string->size = length;
+    return true;
+  }
+
+  // Like |ReadUTF8|, but fails if the string is not well formed UTF-8.
+  bool ReadValidatedUTF8(Span<char>* string) {
+    return ReadUTF8(string) && ValidateUTF8(string->data, string->size);
+  }
+
+  bool ReadValue(StandardValue* value) {
+    uint8_t type = 0;
+    if (!ReadByte(&type)) {
+      return false;
+    }
+    *value = StandardValue();
+    value->type = static_cast<StandardCodecType>(type);
+    switch (value->type) {
+      case StandardCodecType::kNull:
+        return true;
+      case StandardCodecType::kTrue:
+      case StandardCodecType::kFalse:
+        value->bool_value = value->type == StandardCodecType::kTrue;
+        return true;
+      case StandardCodecType::kInt32: {
+        int32_t int_value = 0;
+        if (!ReadBytes(&int_value, sizeof(int_value))) {
+          return false;
+        }
+        value->int_value = int_value;
+        return true;
+      }
+      case StandardCodecType::kInt64:
+        return ReadBytes(&value->int_value, sizeof(value->int_value));
+      case StandardCodecType::kFloat64:
+        return ReadAlignment(8) &&
+               ReadBytes(&value->double_value, sizeof(value->double_value));
+      case StandardCodecType::kLargeInt:
+      case StandardCodecType::kString: {
+        Span<char> string;
+        if (!ReadUTF8(&string)) {
+          return false;
+        }
+        value->data = reinterpret_cast<const uint8_t*>(string.data);
+        value->count = string.size;
+        return true;
+      }
+      case StandardCodecType::kUInt8Data:
+        return ReadTypedData(value, 1);
+      case StandardCodecType::kInt32Data:
+        return ReadTypedData(value, 4);
+      case StandardCodecType::kInt64Data:
+      case StandardCodecType::kFloat64Data:
+        return ReadTypedData(value, 8);
+      case StandardCodecType::kList:
+      case StandardCodecType::kMap: {
+        uint32_t count = 0;
+        if (!ReadSize(&count)) {
+          return false;
+        }
+        value->count = count;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Skips the next value, including the elements of lists and maps.
+  bool SkipValue() {
+    size_t pending = 1;
+    while (pending > 0) {
+      StandardValue value;
+      if (!ReadValue(&value)) {
+        return false;
+      }
+      pending--;
+      if (value.type == StandardCodecType::kList) {
+        pending += value.count;
+      } else if (value.type == StandardCodecType::kMap) {
+        pending += value.count * 2;
+      }
+    }
+    return true;
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_ = 0;
+
+  bool Borrow(size_t length, const uint8_t** bytes) {
+    if (length > size_ - position_) {
+      return false;
+    }
+    *bytes = data_ + position_;
+    position_ += length;
+    return true;
+  }
+
+  bool ReadTypedData(StandardValue* value, uint8_t element_size) {
+    uint32_t count = 0;
+    if (!ReadSize(&count)) {
+      return false;
+    }
+    if (element_size > 1 && !ReadAlignment(element_size)) {
+      return false;
+    }
+    if (count > (size_ - position_) / element_size) {
+      return false;
+    }
+    value->data = data_ + position_;
+    value->count = count;
+    position_ += static_cast<size_t>(count) * element_size;
+    return true;
+  }
+};
+
+}  // namespace codec
+}  // namespace flutter
+
+#endif  // FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_CORE_H_
@@ -0,0 +1,215 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/platform/common/cpp/standard_codec_core.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace flutter {
+namespace codec {
+namespace testing {
+
+static std::vector<uint8_t> Bytes(const StandardWriter& writer) {
+  return std::vector<uint8_t>(writer.data(), writer.data() + writer.size());
+}
+
+// The expected bytes below are what the Dart StandardMessageCodec produces on
+// a little endian host.
+
+TEST(StandardCodecCoreTest, EncodesScalarsLikeTheDartCodec) {
+  StandardWriter writer;
+  writer.WriteNull();
+  writer.WriteBool(true);
+  writer.WriteBool(false);
+  writer.WriteInteger(-2);
+  writer.WriteInteger(0x100000000ll);
+  std::vector<uint8_t> expected = {
+      0x00, 0x01, 0x02,                                // null, true, false
+      0x03, 0xfe, 0xff, 0xff, 0xff,                    // int32 -2
+      0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0, 0, 0,     // int64 2^32
+  };
+  EXPECT_EQ(Bytes(writer), expected);
+}
+
+TEST(StandardCodecCoreTest, AlignsDoublesToTheStartOfTheMessage) {
+  StandardWriter writer;
+  writer.WriteDouble(1.0);
+  std::vector<uint8_t> expected = {
+      0x06, 0, 0, 0, 0, 0, 0, 0,                // type and padding
+      0x00, 0, 0, 0, 0, 0, 0xf0, 0x3f,          // 1.0
+  };
+  EXPECT_EQ(Bytes(writer), expected);
+}
+
+TEST(StandardCodecCoreTest, EncodesSizesLikeTheDartCodec) {
+  StandardWriter writer;
+  writer.WriteSize(253);
+  writer.WriteSize(254);
+  writer.WriteSize(0xffff);
+  writer.WriteSize(0x10000);
+  std::vector<uint8_t> expected = {
+      0xfd,                          //
+      0xfe, 0xfe, 0x00,              //
+      0xfe, 0xff, 0xff,              //
+      0xff, 0x00, 0x00, 0x01, 0x00,  //
+  };
+  EXPECT_EQ(Bytes(writer), expected);
+
+  StandardReader reader(writer.data(), writer.size());
+  uint32_t size = 0;
+  ASSERT_TRUE(reader.ReadSize(&size));
+  EXPECT_EQ(size, 253u);
+  ASSERT_TRUE(reader.ReadSize(&size));
+  EXPECT_EQ(size, 254u);
+  ASSERT_TRUE(reader.ReadSize(&size));
+  EXPECT_EQ(size, 0xffffu);
+  ASSERT_TRUE(reader.ReadSize(&size));
+  EXPECT_EQ(size, 0x10000u);
+  EXPECT_FALSE(reader.HasMore());
+}
+
+TEST(StandardCodecCoreTest, EncodesStringsAsUTF8) {
+  StandardWriter writer;
+  writer.WriteString("h\xc3\xa9", 3);
+  writer.WriteStringUTF16(u"hé", 2);
+  std::vector<uint8_t> expected = {
+      0x07, 0x03, 'h', 0xc3, 0xa9,  //
+      0x07, 0x03, 'h', 0xc3, 0xa9,  //
+  };
+  EXPECT_EQ(Bytes(writer), expected);
+}
+
+TEST(StandardCodecCoreTest, AlignsTypedDataElements) {
+  StandardWriter writer;
+  writer.WriteNull();
+  int32_t elements[] = {1, -1};
+  writer.WriteInt32Data(elements, 2);
+  std::vector<uint8_t> expected = {
+      0x00, 0x09, 0x02, 0x00,  // null, type, count and padding
+      0x01, 0x00, 0x00, 0x00,  //
+      0xff, 0xff, 0xff, 0xff,  //
+  };
+  EXPECT_EQ(Bytes(writer), expected);
+
+  StandardReader reader(writer.data(), writer.size());
+  StandardValue value;
+  ASSERT_TRUE(reader.ReadValue(&value));
+  ASSERT_TRUE(reader.ReadValue(&value));
+  Span<int32_t> view;
+  ASSERT_TRUE(GetTypedData(value, &view));
+  EXPECT_EQ(view.data, reinterpret_cast<const int32_t*>(writer.data() + 4));
+  ASSERT_EQ(view.size, 2u);
+  EXPECT_EQ(view.data[1], -1);
+  Span<double> wrong_type;
+  EXPECT_FALSE(GetTypedData(value, &wrong_type));
+}
+
+TEST(StandardCodecCoreTest, ReservedTypedDataIsWrittenInPlace) {
+  StandardWriter writer;
+  double* elements = writer.ReserveFloat64Data(2);
+  elements[0] = 0.5;
+  elements[1] = 2.0;
+
+  StandardReader reader(writer.data(), writer.size());
+  StandardValue value;
+  ASSERT_TRUE(reader.ReadValue(&value));
+  Span<double> view;
+  ASSERT_TRUE(GetTypedData(value, &view));
+  ASSERT_EQ(view.size, 2u);
+  EXPECT_EQ(view.data[0], 0.5);
+  EXPECT_EQ(view.data[1], 2.0);
+}
+
+TEST(StandardCodecCoreTest, RoundTripsNestedCollections) {
+  StandardWriter writer;
+  writer.WriteMapHeader(1);
+  writer.WriteString("list", 4);
+  writer.WriteListHeader(2);
+  writer.WriteInt64(42);
+  writer.WriteLargeInt("ff", 2);
+  writer.WriteBool(true);
+
+  StandardReader reader(writer.data(), writer.size());
+  StandardValue value;
+  ASSERT_TRUE(reader.ReadValue(&value));
+  EXPECT_EQ(value.type, StandardCodecType::kMap);
+  EXPECT_EQ(value.count, 1u);
+  ASSERT_TRUE(reader.ReadValue(&value));
+  EXPECT_EQ(value.type, StandardCodecType::kString);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(value.data), value.count),
+            "list");
+  ASSERT_TRUE(reader.ReadValue(&value));
+  EXPECT_EQ(value.type, StandardCodecType::kList);
+  EXPECT_EQ(value.count, 2u);
+  ASSERT_TRUE(reader.ReadValue(&value));
+  EXPECT_EQ(value.int_value, 42);
+  ASSERT_TRUE(reader.ReadValue(&value));
+  EXPECT_EQ(value.type, StandardCodecType::kLargeInt);
+
+  StandardReader skipping_reader(writer.data(), writer.size());
+  ASSERT_TRUE(skipping_reader.SkipValue());
+  ASSERT_TRUE(skipping_reader.ReadValue(&value));
+  EXPECT_TRUE(value.bool_value);
+  EXPECT_FALSE(skipping_reader.HasMore());
+}
+
+TEST(StandardCodecCoreTest, RejectsTruncatedMessages) {
+  StandardWriter writer;
+  writer.WriteString("hello", 5);
+  writer.WriteInt64Data(nullptr, 0);
+  writer.WriteDouble(3.0);
+  for (size_t size = 0; size < writer.size(); size++) {
+    StandardReader reader(writer.data(), size);
+    bool complete = true;
+    for (int i = 0; i < 3 && complete; i++) {
+      StandardValue value;
+      complete = reader.ReadValue(&value);
+    }
+    EXPECT_FALSE(complete) << "size " << size;
+  }
+
+  std::vector<uint8_t> oversized = {0x0b, 0xff, 0xff, 0xff, 0xff, 0x7f};
+  StandardReader reader(oversized.data(), oversized.size());
+  StandardValue value;
+  EXPECT_FALSE(reader.ReadValue(&value));
+}
+
+TEST(StandardCodecCoreTest, ResetKeepsTheBuffer) {
+  StandardWriter writer(16);
+  std::string string(100, 'a');
+  writer.WriteString(string.data(), string.size());
+  size_t allocated = writer.bytes_allocated();
+  writer.Reset();
+  writer.WriteString(string.data(), string.size());
+  EXPECT_EQ(writer.bytes_allocated(), allocated);
+}
+
+TEST(StandardCodecCoreTest, ReleaseStartsOverFromTheInitialCapacity) {
+  StandardWriter writer(16);
+  std::string string(1000, 'a');
+  writer.WriteString(string.data(), string.size());
+
+  size_t size = 0;
+  std::unique_ptr<uint8_t[]> message = writer.Release(&size);
+  ASSERT_TRUE(message);
+  EXPECT_EQ(size, 1004u);
+  EXPECT_EQ(message[0], 0x07);
+  EXPECT_EQ(writer.size(), 0u);
+
+  size_t allocated = writer.bytes_allocated();
+  writer.WriteNull();
+  EXPECT_EQ(writer.bytes_allocated(), allocated + 16);
+
+  // The new buffer still grows as needed.
+  writer.WriteString(string.data(), string.size());
+  EXPECT_EQ(writer.size(), 1005u);
+  EXPECT_EQ(writer.data()[1], 0x07);
+}
+
+}  // namespace testing
+}  // namespace codec
+}  // namespace flutter
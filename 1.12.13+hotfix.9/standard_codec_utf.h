@@ -0,0 +1,321 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_UTF_H_
+#define FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_UTF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLUTTER_CODEC_UTF_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FLUTTER_CODEC_UTF_NEON 1
+#endif
+
+namespace flutter {
+namespace codec {
+
+// UTF-8 validation and UTF-8 <-> UTF-16 transcoding for the strings of the
+// standard message codec.
+//
+// Channel payloads are dominated by short, mostly ASCII strings (route names,
+// parameter keys). All routines process blocks of 16 bytes (or 8 UTF-16 code
+// units) with SSE2 or NEON, which are available on every 64-bit target and on
+// armv7 iOS devices, and fall back to 8-byte words elsewhere. Non-ASCII
+// sequences are handled one code point at a time.
+
+namespace internal {
+
+// Returns true if the 16 bytes at |bytes| are all ASCII.
+inline bool IsASCIIBlock16(const uint8_t* bytes) {
+#if FLUTTER_CODEC_UTF_SSE2
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  return _mm_movemask_epi8(block) == 0;
+#elif FLUTTER_CODEC_UTF_NEON
+  uint64x2_t high_bits =
+      vreinterpretq_u64_u8(vandq_u8(vld1q_u8(bytes), vdupq_n_u8(0x80)));
+  return (vgetq_lane_u64(high_bits, 0) | vgetq_lane_u64(high_bits, 1)) == 0;
+#else
+  uint64_t words[2];
+  ::memcpy(words, bytes, sizeof(words));
+  return ((words[0] | words[1]) & 0x8080808080808080ull) == 0;
+#endif
+}
+
+// Widens 16 ASCII bytes to 16 UTF-16 code units.
+inline void WidenASCIIBlock16(const uint8_t* bytes, char16_t* utf16) {
+#if FLUTTER_CODEC_UTF_SSE2
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(utf16),
+                   _mm_unpacklo_epi8(block, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(utf16 + 8),
+                   _mm_unpackhi_epi8(block, zero));
+#elif FLUTTER_CODEC_UTF_NEON
+  uint8x16_t block = vld1q_u8(bytes);
+  vst1q_u16(reinterpret_cast<uint16_t*>(utf16), vmovl_u8(vget_low_u8(block)));
+  vst1q_u16(reinterpret_cast<uint16_t*>(utf16 + 8),
+            vmovl_u8(vget_high_u8(block)));
+#else
+  for (size_t i = 0; i < 16; i++) {
+    utf16[i] = bytes[i];
+  }
+#endif
+}
+
+// Narrows 8 UTF-16 code units to 8 bytes if they are all ASCII. Returns false,
+// without writing anything, otherwise.
+inline bool NarrowASCIIBlock8(const char16_t* utf16, uint8_t* bytes) {
+#if FLUTTER_CODEC_UTF_SSE2
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(utf16));
+  __m128i non_ascii =
+      _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xff80)));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, _mm_setzero_si128())) !=
+      0xffff) {
+    return false;
+  }
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(bytes),
+                   _mm_packus_epi16(block, block));
+  return true;
+#elif FLUTTER_CODEC_UTF_NEON
+  uint16x8_t block = vld1q_u16(reinterpret_cast<const uint16_t*>(utf16));
+  uint64x2_t non_ascii =
+      vreinterpretq_u64_u16(vandq_u16(block, vdupq_n_u16(0xff80)));
+  if ((vgetq_lane_u64(non_ascii, 0) | vgetq_lane_u64(non_ascii, 1)) != 0) {
+    return false;
+  }
+  vst1_u8(bytes, vmovn_u16(block));
+  return true;
+#else
+  for (size_t i = 0; i < 8; i++) {
+    if (utf16[i] >= 0x80) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < 8; i++) {
+    bytes[i] = static_cast<uint8_t>(utf16[i]);
+  }
+  return true;
+#endif
+}
+
+// Decodes the non-ASCII sequence at |bytes| and returns its length, or 0 if it
+// is not valid UTF-8 (overlong, surrogate, out of range or truncated).
+inline size_t DecodeUTF8Sequence(const uint8_t* bytes,
+                                 size_t available,
+                                 uint32_t* code_point) {
+  uint8_t lead = bytes[0];
+  size_t length = 0;
+  uint8_t min_second = 0x80;
+  uint8_t max_second = 0xbf;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 2;
+    *code_point = lead & 0x1f;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 3;
+    *code_point = lead & 0x0f;
+    if (lead == 0xe0) {
+      min_second = 0xa0;
+    } else if (lead == 0xed) {
+      max_second = 0x9f;
+    }
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 4;
+    *code_point = lead & 0x07;
+    if (lead == 0xf0) {
+      min_second = 0x90;
+    } else if (lead == 0xf4) {
+      max_second = 0x8f;
+    }
+  } else {
+    return 0;
+  }
+  if (available < length || bytes[1] < min_second || bytes[1] > max_second) {
+    return 0;
+  }
+  *code_point = (*code_point << 6) | (bytes[1] & 0x3f);
+  for (size_t i = 2; i < length; i++) {
+    if ((bytes[i] & 0xc0) != 0x80) {
+      return 0;
+    }
+    *code_point = (*code_point << 6) | (bytes[i] & 0x3f);
+  }
+  return length;
+}
+
+}  // namespace internal
+
+// Returns true if |utf8| is well formed UTF-8.
+inline bool ValidateUTF8(const char* utf8, size_t length) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(utf8);
+  size_t i = 0;
+  while (i < length) {
+    if (length - i >= 16 && internal::IsASCIIBlock16(bytes + i)) {
+      i += 16;
+      continue;
+    }
+    if (bytes[i] < 0x80) {
+      i++;
+      continue;
+    }
+    uint32_t code_point = 0;
+    size_t sequence_length =
+        internal::DecodeUTF8Sequence(bytes + i, length - i, &code_point);
+    if (sequence_length == 0) {
+      return false;
+    }
+    i += sequence_length;
+  }
+  return true;
+}
+
+// Converts well formed UTF-8 to UTF-16. |utf16| must have room for |length|
+// code units, which is the most a UTF-8 string of that length can need.
+// Returns false if |utf8| is not well formed. Otherwise, the number of code
+// units written is stored in |utf16_length|.
+inline bool ConvertUTF8ToUTF16(const char* utf8,
+                               size_t length,
+                               char16_t* utf16,
+                               size_t* utf16_length) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(utf8);
+  size_t i = 0;
+  size_t written = 0;
+  while (i < length) {
+    if (length - i >= 16 && internal::IsASCIIBlock16(bytes + i)) {
+      internal::WidenASCIIBlock16(bytes + i, utf16 + written);
+      i += 16;
+      written += 16;
+      continue;
+    }
+    if (bytes[i] < 0x80) {
+      utf16[written++] = bytes[i++];
+      continue;
+    }
+    uint32_t code_point = 0;
+    size_t sequence_length =
+        internal::DecodeUTF8Sequence(bytes + i, length - i, &code_point);
+    if (sequence_length == 0) {
+      return false;
+    }
+    i += sequence_length;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      utf16[written++] = static_cast<char16_t>(0xd800 + (code_point >> 10));
+      utf16[written++] = static_cast<char16_t>(0xdc00 + (code_point & 0x3ff));
+    } else {
+      utf16[written++] = static_cast<char16_t>(code_point);
+    }
+  }
+  *utf16_length = written;
+  return true;
+}
+
+namespace internal {
+
+// Returns the code point of the UTF-16 sequence at |utf16| and stores its
+// length in |units|. Unpaired surrogates are replaced by U+FFFD.
+inline uint32_t DecodeUTF16Sequence(const char16_t* utf16,
+                                    size_t available,
+                                    size_t* units) {
+  uint32_t unit = utf16[0];
+  *units = 1;
+  if (unit < 0xd800 || unit > 0xdfff) {
+    return unit;
+  }
+  if (unit <= 0xdbff && available > 1 && utf16[1] >= 0xdc00 &&
+      utf16[1] <= 0xdfff) {
+    *units = 2;
+    return 0x10000 + ((unit - 0xd800) << 10) + (utf16[1] - 0xdc00);
+  }
+  return 0xfffd;
+}
+
+inline size_t UTF8SequenceLength(uint32_t code_point) {
+  if (code_point < 0x80) {
+    return 1;
+  }
+  if (code_point < 0x800) {
+    return 2;
+  }
+  return code_point < 0x10000 ? 3 : 4;
+}
+
+}  // namespace internal
+
+// Returns the number of bytes needed to encode |utf16| as UTF-8.
+inline size_t UTF8LengthOfUTF16(const char16_t* utf16, size_t length) {
+  size_t i = 0;
+  size_t utf8_length = 0;
+  while (i < length) {
+    uint8_t ascii[8];
+    if (length - i >= 8 && internal::NarrowASCIIBlock8(utf16 + i, ascii)) {
+      i += 8;
+      utf8_length += 8;
+      continue;
+    }
+    size_t units = 0;
+    uint32_t code_point =
+        internal::DecodeUTF16Sequence(utf16 + i, length - i, &units);
+    i += units;
+    utf8_length += internal::UTF8SequenceLength(code_point);
+  }
+  return utf8_length;
+}
+
+// Converts UTF-16 to UTF-8, replacing unpaired surrogates by U+FFFD. |utf8|
+// must have room for |UTF8LengthOfUTF16| bytes. Returns the number of bytes
+// written.
+inline size_t ConvertUTF16ToUTF8(const char16_t* utf16,
+                                 size_t length,
+                                 char* utf8) {
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(utf8);
+  size_t i = 0;
+  size_t written = 0;
+  while (i < length) {
+    if (length - i >= 8 &&
+        internal::NarrowASCIIBlock8(utf16 + i, bytes + written)) {
+      i += 8;
+      written += 8;
+      continue;
+    }
+    size_t units = 0;
+    uint32_t code_point =
+        internal::DecodeUTF16Sequence(utf16 + i, length - i, &units);
+    i += units;
+    switch (internal::UTF8SequenceLength(code_point)) {
+      case 1:
+        bytes[written++] = static_cast<uint8_t>(code_point);
+        break;
+      case 2:
+        bytes[written++] = static_cast<uint8_t>(0xc0 | (code_point >> 6));
+        bytes[written++] = static_cast<uint8_t>(0x80 | (code_point & 0x3f));
+        break;
+      case 3:
+        bytes[written++] = static_cast<uint8_t>(0xe0 | (code_point >> 12));
+        bytes[written++] =
+            static_cast<uint8_t>(0x80 | ((code_point >> 6) & 0x3f));
+        bytes[written++] = static_cast<uint8_t>(0x80 | (code_point & 0x3f));
+        break;
+      default:
+        bytes[written++] = static_cast<uint8_t>(0xf0 | (code_point >> 18));
+        bytes[written++] =
+            static_cast<uint8_t>(0x80 | ((code_point >> 12) & 0x3f));
+        bytes[written++] =
+            static_cast<uint8_t>(0x80 | ((code_point >> 6) & 0x3f));
+        bytes[written++] = static_cast<uint8_t>(0x80 | (code_point & 0x3f));
+        break;
+    }
+  }
+  return written;
+}
+
+}  // namespace codec
+}  // namespace flutter
+
+#endif  // FLUTTER_SHELL_PLATFORM_COMMON_CPP_STANDARD_CODEC_UTF_H_
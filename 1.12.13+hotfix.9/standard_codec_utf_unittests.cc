@@ -0,0 +1,142 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/shell/platform/common/cpp/standard_codec_utf.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace flutter {
+namespace codec {
+namespace testing {
+
+// Straightforward encoders to check the block based routines against.
+static void AppendUTF8(uint32_t code_point, std::string* utf8) {
+  if (code_point < 0x80) {
+    utf8->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    utf8->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    utf8->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    utf8->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+    utf8->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    utf8->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+static void AppendUTF16(uint32_t code_point, std::u16string* utf16) {
+  if (code_point < 0x10000) {
+    utf16->push_back(static_cast<char16_t>(code_point));
+  } else {
+    code_point -= 0x10000;
+    utf16->push_back(static_cast<char16_t>(0xd800 + (code_point >> 10)));
+    utf16->push_back(static_cast<char16_t>(0xdc00 + (code_point & 0x3ff)));
+  }
+}
+
+// Strings with a single non-ASCII code point at every position of an ASCII run
+// long enough to cover several blocks, so both the vector and the scalar paths
+// see it.
+struct TestString {
+  std::string utf8;
+  std::u16string utf16;
+};
+
+static std::vector<TestString> MakeTestStrings() {
+  const uint32_t kCodePoints[] = {0xe9, 0x7ff, 0x800, 0x4e2d, 0xffff,
+                                  0x10000, 0x1f600, 0x10ffff};
+  std::vector<TestString> strings;
+  for (size_t length = 0; length <= 40; length++) {
+    TestString ascii;
+    for (size_t i = 0; i < length; i++) {
+      AppendUTF8('a' + i % 26, &ascii.utf8);
+      AppendUTF16('a' + i % 26, &ascii.utf16);
+    }
+    strings.push_back(ascii);
+    for (uint32_t code_point : kCodePoints) {
+      for (size_t position = 0; position <= length; position++) {
+        TestString string;
+        for (size_t i = 0; i <= length; i++) {
+          uint32_t c = i == position ? code_point : 'a' + i % 26;
+          AppendUTF8(c, &string.utf8);
+          AppendUTF16(c, &string.utf16);
+        }
+        strings.push_back(string);
+      }
+    }
+  }
+  return strings;
+}
+
+TEST(StandardCodecUTFTest, ConvertsUTF8ToUTF16) {
+  for (const TestString& string : MakeTestStrings()) {
+    ASSERT_TRUE(ValidateUTF8(string.utf8.data(), string.utf8.size()));
+    std::u16string utf16(string.utf8.size(), u'\0');
+    size_t utf16_length = 0;
+    ASSERT_TRUE(ConvertUTF8ToUTF16(string.utf8.data(), string.utf8.size(),
+                                   &utf16[0], &utf16_length));
+    utf16.resize(utf16_length);
+    EXPECT_EQ(utf16, string.utf16);
+  }
+}
+
+TEST(StandardCodecUTFTest, ConvertsUTF16ToUTF8) {
+  for (const TestString& string : MakeTestStrings()) {
+    size_t utf8_length =
+        UTF8LengthOfUTF16(string.utf16.data(), string.utf16.size());
+    ASSERT_EQ(utf8_length, string.utf8.size());
+    std::string utf8(utf8_length, '\0');
+    EXPECT_EQ(
+        ConvertUTF16ToUTF8(string.utf16.data(), string.utf16.size(), &utf8[0]),
+        utf8_length);
+    EXPECT_EQ(utf8, string.utf8);
+  }
+}
+
+TEST(StandardCodecUTFTest, ReplacesUnpairedSurrogates) {
+  const char16_t utf16[] = {'a', 0xd800, 'b', 0xdc00};
+  const std::string expected = "a\xef\xbf\xbd" "b\xef\xbf\xbd";
+  ASSERT_EQ(UTF8LengthOfUTF16(utf16, 4), expected.size());
+  std::string utf8(expected.size(), '\0');
+  EXPECT_EQ(ConvertUTF16ToUTF8(utf16, 4, &utf8[0]), expected.size());
+  EXPECT_EQ(utf8, expected);
+}
+
+TEST(StandardCodecUTFTest, RejectsMalformedUTF8) {
+  const std::string kMalformed[] = {
+      "\x80",              // Continuation without a lead byte.
+      "\xc0\x80",          // Overlong.
+      "\xc1\xbf",          // Overlong.
+      "\xe0\x80\x80",      // Overlong.
+      "\xf0\x80\x80\x80",  // Overlong.
+      "\xed\xa0\x80",      // Surrogate.
+      "\xf4\x90\x80\x80",  // Beyond U+10FFFF.
+      "\xf5\x80\x80\x80",  // Invalid lead byte.
+      "\xe4\xb8",          // Truncated.
+      "\xe4\x41\xad",      // Missing continuation.
+  };
+  for (const std::string& sequence : kMalformed) {
+    for (size_t position = 0; position <= 20; position++) {
+      std::string utf8 = std::string(position, 'a') + sequence +
+                         std::string(20 - position, 'a');
+      EXPECT_FALSE(ValidateUTF8(utf8.data(), utf8.size()))
+          << "at position " << position;
+      std::u16string utf16(utf8.size(), u'\0');
+      size_t utf16_length = 0;
+      EXPECT_FALSE(ConvertUTF8ToUTF16(utf8.data(), utf8.size(), &utf16[0],
+                                      &utf16_length));
+    }
+  }
+}
+
+}  // namespace testing
+}  // namespace codec
+}  // namespace flutter
@@ -0,0 +1,127 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/runtime/startup_timeline.h"
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace flutter {
+
+static const char* SourceName(StartupTimeline::Source source) {
+  switch (source) {
+    case StartupTimeline::Source::kNone:
+      return "none";
+    case StartupTimeline::Source::kCallback:
+      return "callback";
+    case StartupTimeline::Source::kFile:
+      return "file";
+    case StartupTimeline::Source::kSymbol:
+      return "symbol";
+    case StartupTimeline::Source::kExternalPointer:
+      return "external_pointer";
+    case StartupTimeline::Source::kSharedMemory:
+      return "shared_memory";
+  }
+  return "none";
+}
+
+static void WriteJSONString(std::ostream& stream, const std::string& string) {
+  stream << '"';
+  for (char c : string) {
+    switch (c) {
+      case '"':
+        stream << "\\\"";
+        break;
+      case '\\':
+        stream << "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          stream << ' ';
+        } else {
+          stream << c;
+        }
+    }
+  }
+  stream << '"';
+}
+
+StartupTimeline& StartupTimeline::GetInstance() {
+  static StartupTimeline* timeline = new StartupTimeline();
+  return *timeline;
+}
+
+StartupTimeline::StartupTimeline() = default;
+
+StartupTimeline::~StartupTimeline() = default;
+
+void StartupTimeline::Mark(std::string name) {
+  auto now = fml::TimePoint::Now();
+  Record(std::move(name), now, now);
+}
+
+void StartupTimeline::Record(std::string name,
+                             fml::TimePoint start,
+                             fml::TimePoint end,
+                             size_t bytes,
+                             Source source) {
+  Milestone milestone;
+  milestone.name = std::move(name);
+  milestone.start = start;
+  milestone.duration = end - start;
+  milestone.bytes = bytes;
+  milestone.source = source;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  milestones_.push_back(std::move(milestone));
+}
+
+std::vector<StartupTimeline::Milestone> StartupTimeline::GetMilestones()
+    const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return milestones_;
+}
+
+std::string StartupTimeline::GetReport() const {
+  auto milestones = GetMilestones();
+  fml::TimePoint origin;
+  for (size_t i = 0; i < milestones.size(); i++) {
+    if (i == 0 || milestones[i].start < origin) {
+      origin = milestones[i].start;
+    }
+  }
+
+  std::ostringstream stream;
+  stream << "{\"milestones\":[";
+  for (size_t i = 0; i < milestones.size(); i++) {
+    const auto& milestone = milestones[i];
+    if (i > 0) {
+      stream << ',';
+    }
+    stream << "{\"name\":";
+    WriteJSONString(stream, milestone.name);
+    stream << ",\"start_us\":" << (milestone.start - origin).ToMicroseconds()
+           << ",\"duration_us\":" << milestone.duration.ToMicroseconds();
+    if (milestone.source != Source::kNone) {
+      stream << ",\"bytes\":" << milestone.bytes << ",\"source\":\""
+             << SourceName(milestone.source) << '"';
+    }
+    stream << '}';
+  }
+  stream << "]}";
+  return stream.str();
+}
+
+bool StartupTimeline::WriteReport(const std::string& path) const {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file << GetReport();
+  return static_cast<bool>(file);
+}
+
+}  // namespace flutter
@@ -0,0 +1,73 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_RUNTIME_STARTUP_TIMELINE_H_
+#define FLUTTER_RUNTIME_STARTUP_TIMELINE_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "flutter/fml/macros.h"
+#include "flutter/fml/time/time_point.h"
+
+namespace flutter {
+
+// The milestones on the critical path of a cold start (settings construction,
+// snapshot resolution, VM and isolate creation, first frame) of all engines in
+// the process, in the order in which they were recorded.
+class StartupTimeline {
+ public:
+  // Where a resolved snapshot piece came from.
+  enum class Source {
+    kNone,
+    kCallback,
+    kFile,
+    kSymbol,
+    kExternalPointer,
+    kSharedMemory,
+  };
+
+  struct Milestone {
+    std::string name;
+    fml::TimePoint start;
+    fml::TimeDelta duration;
+    size_t bytes = 0;
+    Source source = Source::kNone;
+  };
+
+  static StartupTimeline& GetInstance();
+
+  // Records a point in time.
+  void Mark(std::string name);
+
+  // Records a span and, for resolved data, its size and source.
+  void Record(std::string name,
+              fml::TimePoint start,
+              fml::TimePoint end,
+              size_t bytes = 0,
+              Source source = Source::kNone);
+
+  std::vector<Milestone> GetMilestones() const;
+
+  // Returns the milestones as a JSON report. Times are in microseconds
+  // relative to the first milestone.
+  std::string GetReport() const;
+
+  bool WriteReport(const std::string& path) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Milestone> milestones_;
+
+  StartupTimeline();
+
+  ~StartupTimeline();
+
+  FML_DISALLOW_COPY_AND_ASSIGN(StartupTimeline);
+};
+
+}  // namespace flutter
+
+#endif  // FLUTTER_RUNTIME_STARTUP_TIMELINE_H_
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Strips an ICU data file down to the locales an application declares.
+
+The locale specific resource bundles make up most of icudtl.dat. Bundles of
+undeclared languages are removed from every locale tree. Everything else
+(root bundles, converters, normalization and break iterator data) is kept, so
+lookups of removed locales fall back to the root locale.
+
+Usage:
+  strip_icu_data.py --icupkg path/to/icupkg --input icudtl.dat \\
+      --output icudtl_stripped.dat --locales en,zh_Hans,ja
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# The trees of the ICU data file whose items are keyed by locale.
+LOCALE_TREES = ['', 'brkitr', 'coll', 'curr', 'lang', 'rbnf', 'region', 'unit',
+                'zone']
+
+# Bundles in the locale trees that are not locales.
+NON_LOCALE_BUNDLES = ['root', 'pool', 'res_index', 'supplementalData',
+                      'metaZones', 'timezoneTypes', 'windowsZones',
+                      'keyTypeData', 'likelySubtags', 'numberingSystems',
+                      'genderList', 'plurals', 'dayPeriods', 'tzdbNames',
+                      'icustd', 'icuver', 'zoneinfo64', 'grammaticalFeatures']
+
+LOCALE_PATTERN = re.compile(r'^([a-z]{2,3})(_[A-Za-z0-9]+)*$')
+
+
+def ListItems(icupkg, input_path):
+  output = subprocess.check_output([icupkg, '--list', input_path])
+  return [line.strip() for line in output.decode('utf-8').splitlines()
+          if line.strip()]
+
+
+def ItemLanguage(item):
+  """Returns the language of a locale bundle item, or None if the item is not
+  a locale bundle."""
+  tree, name = os.path.split(item)
+  base, extension = os.path.splitext(name)
+  if extension != '.res' or tree not in LOCALE_TREES:
+    return None
+  if base in NON_LOCALE_BUNDLES:
+    return None
+  match = LOCALE_PATTERN.match(base)
+  if not match:
+    return None
+  return match.group(1)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--icupkg', required=True,
+      help='Path to the icupkg tool of the ICU version the engine uses.')
+  parser.add_argument('--input', required=True, help='The full icudtl.dat.')
+  parser.add_argument('--output', required=True,
+      help='Where to write the stripped ICU data file.')
+  parser.add_argument('--locales', required=True,
+      help='Comma separated list of the locales to keep (e.g. en,zh_Hans).')
+  args = parser.parse_args()
+
+  languages = set()
+  for locale in args.locales.split(','):
+    locale = locale.strip().replace('-', '_')
+    if locale:
+      languages.add(locale.split('_')[0].lower())
+  if not languages:
+    print('No locales to keep were specified.')
+    return 1
+
+  removed = []
+  for item in ListItems(args.icupkg, args.input):
+    language = ItemLanguage(item)
+    if language is not None and language not in languages:
+      removed.append(item)
+
+  remove_list = tempfile.NamedTemporaryFile(mode='w', suffix='.txt',
+                                            delete=False)
+  try:
+    remove_list.write('\n'.join(removed) + '\n')
+    remove_list.close()
+    subprocess.check_call([args.icupkg, '--remove', remove_list.name,
+                           args.input, args.output])
+  finally:
+    os.remove(remove_list.name)
+
+  print('Removed %d locale bundles, %d -> %d bytes.' % (len(removed),
+      os.path.getsize(args.input), os.path.getsize(args.output)))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
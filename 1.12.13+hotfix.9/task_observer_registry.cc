@@ -0,0 +1,193 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/task_observer_registry.h"
+
+#include <utility>
+
+#include "flutter/fml/message_loop.h"
+
+namespace fml {
+
+constexpr size_t TaskObserverRegistry::kCapacity;
+constexpr size_t TaskObserverRegistry::kNotifyOnFlushOnly;
+
+TaskObserverRegistry& TaskObserverRegistry::ForCurrentThread() {
+  thread_local TaskObserverRegistry registry;
+  return registry;
+}
+
+TaskObserverRegistry::TaskObserverRegistry() = default;
+
+TaskObserverRegistry::~TaskObserverRegistry() = default;
+
+TaskObserverRegistry::Entry* TaskObserverRegistry::Find(intptr_t key) {
+  for (size_t i = 0; i < count_; i++) {
+    if (!entries_[i].removed && entries_[i].key == key) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+TaskObserverRegistry::Entry* TaskObserverRegistry::Append(intptr_t key) {
+  if (Entry* existing = Find(key)) {
+    if (notify_depth_ == 0) {
+      *existing = Entry{};
+      existing->key = key;
+      return existing;
+    }
+    // The observer being replaced may be the one being notified, so its entry
+    // is left alone until the notification is over.
+    existing->removed = true;
+    needs_compaction_ = true;
+  }
+  if (count_ == kCapacity && notify_depth_ == 0) {
+    Compact();
+  }
+  if (count_ == kCapacity) {
+    return nullptr;
+  }
+  if (count_ == 0 && !AttachToMessageLoop()) {
+    return nullptr;
+  }
+  Entry* entry = &entries_[count_++];
+  *entry = Entry{};
+  entry->key = key;
+  return entry;
+}
+
+bool TaskObserverRegistry::Add(intptr_t key,
+                               ObserverProc proc,
+                               void* context,
+                               size_t stride) {
+  if (proc == nullptr || stride == 0) {
+    return false;
+  }
+  Entry* entry = Append(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  entry->proc = proc;
+  entry->context = context;
+  entry->stride = stride;
+  return true;
+}
+
+bool TaskObserverRegistry::Add(intptr_t key, fml::closure closure) {
+  if (!closure) {
+    return false;
+  }
+  Entry* entry = Append(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  entry->closure = std::move(closure);
+  return true;
+}
+
+bool TaskObserverRegistry::Remove(intptr_t key) {
+  Entry* entry = Find(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  // Entries are only marked while observers are being notified so that the
+  // iteration in progress is not disturbed.
+  entry->removed = true;
+  needs_compaction_ = true;
+  if (notify_depth_ == 0) {
+    Compact();
+  }
+  return true;
+}
+
+void TaskObserverRegistry::Compact() {
+  if (!needs_compaction_) {
+    return;
+  }
+  size_t live = 0;
+  for (size_t i = 0; i < count_; i++) {
+    if (entries_[i].removed) {
+      continue;
+    }
+    if (live != i) {
+      entries_[live] = std::move(entries_[i]);
+    }
+    live++;
+  }
+  for (size_t i = live; i < count_; i++) {
+    entries_[i] = Entry{};
+  }
+  const bool was_attached = count_ > 0;
+  count_ = live;
+  needs_compaction_ = false;
+  if (was_attached && count_ == 0) {
+    DetachFromMessageLoop();
+  }
+}
+
+void TaskObserverRegistry::Notify(Entry& entry) {
+  const size_t tasks = entry.pending;
+  entry.pending = 0;
+  if (entry.proc != nullptr) {
+    entry.proc(entry.context, tasks);
+  } else {
+    // Entries are not moved or cleared while observers are being notified, so
+    // the closure stays alive even if the observer removes itself.
+    entry.closure();
+  }
+}
+
+void TaskObserverRegistry::DidProcessTask() {
+  tasks_since_flush_++;
+  notify_depth_++;
+  // Observers added while notifying start with the next task.
+  const size_t count = count_;
+  for (size_t i = 0; i < count; i++) {
+    Entry& entry = entries_[i];
+    if (entry.removed) {
+      continue;
+    }
+    if (++entry.pending >= entry.stride) {
+      Notify(entry);
+    }
+  }
+  if (--notify_depth_ == 0) {
+    Compact();
+  }
+}
+
+void TaskObserverRegistry::Flush() {
+  tasks_since_flush_ = 0;
+  notify_depth_++;
+  const size_t count = count_;
+  for (size_t i = 0; i < count; i++) {
+    Entry& entry = entries_[i];
+    if (!entry.removed && entry.pending > 0) {
+      Notify(entry);
+    }
+  }
+  if (--notify_depth_ == 0) {
+    Compact();
+  }
+}
+
+bool TaskObserverRegistry::AttachToMessageLoop() {
+  if (!MessageLoop::IsInitializedForCurrentThread()) {
+    return false;
+  }
+  MessageLoop::GetCurrent().AddTaskObserver(
+      reinterpret_cast<intptr_t>(this), [this]() { DidProcessTask(); });
+  return true;
+}
+
+void TaskObserverRegistry::DetachFromMessageLoop() {
+  if (!MessageLoop::IsInitializedForCurrentThread()) {
+    return;
+  }
+  MessageLoop::GetCurrent().RemoveTaskObserver(
+      reinterpret_cast<intptr_t>(this));
+}
+
+}  // namespace fml
@@ -0,0 +1,112 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_TASK_OBSERVER_REGISTRY_H_
+#define FLUTTER_FML_TASK_OBSERVER_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "flutter/fml/closure.h"
+#include "flutter/fml/macros.h"
+
+namespace fml {
+
+// The task observers of a thread, kept in a small fixed-capacity array.
+//
+// The message loop only ever sees a single observer per thread, the registry,
+// instead of one type-erased callback per registered observer. Observers
+// registered as plain functions are called directly. Observers that do not
+// need to run after every task can ask to be notified only once every
+// |stride| tasks, or only when the registry is flushed (e.g. when the thread
+// goes idle). They receive the number of tasks run since they were last
+// notified.
+//
+// A registry must only be used on its own thread. Observers may add or remove
+// observers (including themselves) while being notified.
+class TaskObserverRegistry {
+ public:
+  static constexpr size_t kCapacity = 8;
+
+  // Observers with this stride are only notified by |Flush|.
+  static constexpr size_t kNotifyOnFlushOnly = SIZE_MAX;
+
+  using ObserverProc = void (*)(void* context, size_t tasks);
+
+  // Returns the registry of the calling thread.
+  static TaskObserverRegistry& ForCurrentThread();
+
+  // Adds an observer called once every |stride| tasks. Like
+  // |MessageLoop::AddTaskObserver|, an observer already added with the same
+  // key is replaced. Returns false if the registry is full or if the calling
+  // thread has no message loop to run the observers after its tasks.
+  bool Add(intptr_t key, ObserverProc proc, void* context, size_t stride = 1);
+
+  // Adds an observer that calls |Method| on |object|.
+  template <class T, void (T::*Method)(size_t)>
+  bool Add(intptr_t key, T* object, size_t stride = 1) {
+    return Add(
+        key,
+        [](void* context, size_t tasks) {
+          (static_cast<T*>(context)->*Method)(tasks);
+        },
+        object, stride);
+  }
+
+  // Adds an observer called after every task.
+  bool Add(intptr_t key, fml::closure closure);
+
+  // Returns false if no observer with this key was registered.
+  bool Remove(intptr_t key);
+
+  size_t GetObserverCount() const { return count_; }
+
+  // The number of tasks run on this thread since the last |Flush|.
+  size_t GetTasksSinceLastFlush() const { return tasks_since_flush_; }
+
+  // Called by the message loop after each task.
+  void DidProcessTask();
+
+  // Notifies every observer that has not yet seen all the tasks run so far.
+  void Flush();
+
+ private:
+  struct Entry {
+    intptr_t key = 0;
+    ObserverProc proc = nullptr;
+    void* context = nullptr;
+    fml::closure closure;
+    size_t stride = 1;
+    size_t pending = 0;
+    bool removed = false;
+  };
+
+  Entry entries_[kCapacity];
+  size_t count_ = 0;
+  size_t tasks_since_flush_ = 0;
+  size_t notify_depth_ = 0;
+  bool needs_compaction_ = false;
+
+  TaskObserverRegistry();
+
+  ~TaskObserverRegistry();
+
+  Entry* Find(intptr_t key);
+
+  Entry* Append(intptr_t key);
+
+  void Notify(Entry& entry);
+
+  void Compact();
+
+  bool AttachToMessageLoop();
+
+  void DetachFromMessageLoop();
+
+  FML_DISALLOW_COPY_AND_ASSIGN(TaskObserverRegistry);
+};
+
+}  // namespace fml
+
+#endif  // FLUTTER_FML_TASK_OBSERVER_REGISTRY_H_
@@ -0,0 +1,166 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/task_observer_registry.h"
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "flutter/fml/message_loop.h"
+#include "gtest/gtest.h"
+
+namespace fml {
+namespace testing {
+
+// Registries are per thread, so every test uses a thread of its own.
+static void RunOnThread(
+    bool with_message_loop,
+    const std::function<void(TaskObserverRegistry&)>& test) {
+  std::thread thread([&]() {
+    if (with_message_loop) {
+      MessageLoop::EnsureInitializedForCurrentThread();
+    }
+    test(TaskObserverRegistry::ForCurrentThread());
+  });
+  thread.join();
+}
+
+TEST(TaskObserverRegistryTest, AddFailsWithoutMessageLoop) {
+  RunOnThread(false, [](TaskObserverRegistry& registry) {
+    EXPECT_FALSE(registry.Add(1, []() {}));
+    EXPECT_EQ(registry.GetObserverCount(), 0u);
+  });
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    EXPECT_TRUE(registry.Add(1, []() {}));
+    EXPECT_EQ(registry.GetObserverCount(), 1u);
+    EXPECT_TRUE(registry.Remove(1));
+    EXPECT_FALSE(registry.Remove(1));
+  });
+}
+
+TEST(TaskObserverRegistryTest, AddingAKeyAgainReplacesTheObserver) {
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    int first_calls = 0;
+    int second_calls = 0;
+    ASSERT_TRUE(registry.Add(1, [&first_calls]() { first_calls++; }));
+    ASSERT_TRUE(registry.Add(1, [&second_calls]() { second_calls++; }));
+    EXPECT_EQ(registry.GetObserverCount(), 1u);
+
+    registry.DidProcessTask();
+    EXPECT_EQ(first_calls, 0);
+    EXPECT_EQ(second_calls, 1);
+
+    // Replacing the observer being notified takes effect with the next task.
+    int third_calls = 0;
+    ASSERT_TRUE(registry.Add(1, [&registry, &second_calls, &third_calls]() {
+      second_calls++;
+      EXPECT_TRUE(registry.Add(1, [&third_calls]() { third_calls++; }));
+    }));
+    registry.DidProcessTask();
+    EXPECT_EQ(second_calls, 2);
+    EXPECT_EQ(third_calls, 0);
+    registry.DidProcessTask();
+    EXPECT_EQ(second_calls, 2);
+    EXPECT_EQ(third_calls, 1);
+    EXPECT_EQ(registry.GetObserverCount(), 1u);
+
+    EXPECT_TRUE(registry.Remove(1));
+    EXPECT_FALSE(registry.Remove(1));
+  });
+}
+
+TEST(TaskObserverRegistryTest, NotifiesEveryStrideTasks) {
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    int every_task = 0;
+    std::vector<size_t> strided;
+    std::vector<size_t> on_flush;
+    struct Observer {
+      std::vector<size_t>* calls;
+      void OnTasks(size_t tasks) { calls->push_back(tasks); }
+    };
+    Observer strided_observer{&strided};
+    Observer flush_observer{&on_flush};
+
+    ASSERT_TRUE(registry.Add(1, [&every_task]() { every_task++; }));
+    ASSERT_TRUE((registry.Add<Observer, &Observer::OnTasks>(
+        2, &strided_observer, 3)));
+    ASSERT_TRUE((registry.Add<Observer, &Observer::OnTasks>(
+        3, &flush_observer, TaskObserverRegistry::kNotifyOnFlushOnly)));
+
+    for (int i = 0; i < 7; i++) {
+      registry.DidProcessTask();
+    }
+    EXPECT_EQ(every_task, 7);
+    EXPECT_EQ(strided, (std::vector<size_t>{3, 3}));
+    EXPECT_TRUE(on_flush.empty());
+    EXPECT_EQ(registry.GetTasksSinceLastFlush(), 7u);
+
+    registry.Flush();
+    EXPECT_EQ(strided, (std::vector<size_t>{3, 3, 1}));
+    EXPECT_EQ(on_flush, (std::vector<size_t>{7}));
+    EXPECT_EQ(registry.GetTasksSinceLastFlush(), 0u);
+
+    // Nothing is pending, so a second flush notifies nobody.
+    registry.Flush();
+    EXPECT_EQ(on_flush.size(), 1u);
+
+    for (intptr_t key = 1; key <= 3; key++) {
+      EXPECT_TRUE(registry.Remove(key));
+    }
+  });
+}
+
+TEST(TaskObserverRegistryTest, ObserversMayRemoveThemselves) {
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    int calls = 0;
+    int other_calls = 0;
+    ASSERT_TRUE(registry.Add(1, [&registry, &calls]() {
+      calls++;
+      EXPECT_TRUE(registry.Remove(1));
+    }));
+    ASSERT_TRUE(registry.Add(2, [&other_calls]() { other_calls++; }));
+
+    registry.DidProcessTask();
+    registry.DidProcessTask();
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(other_calls, 2);
+    EXPECT_EQ(registry.GetObserverCount(), 1u);
+    EXPECT_TRUE(registry.Remove(2));
+  });
+}
+
+TEST(TaskObserverRegistryTest, ObserversAddedWhileNotifyingStartWithNextTask) {
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    int added_calls = 0;
+    ASSERT_TRUE(registry.Add(1, [&registry, &added_calls]() {
+      if (registry.GetObserverCount() == 1) {
+        registry.Add(2, [&added_calls]() { added_calls++; });
+      }
+    }));
+
+    registry.DidProcessTask();
+    EXPECT_EQ(added_calls, 0);
+    registry.DidProcessTask();
+    EXPECT_EQ(added_calls, 1);
+    EXPECT_TRUE(registry.Remove(1));
+    EXPECT_TRUE(registry.Remove(2));
+  });
+}
+
+TEST(TaskObserverRegistryTest, RejectsObserversBeyondCapacity) {
+  RunOnThread(true, [](TaskObserverRegistry& registry) {
+    for (size_t i = 0; i < TaskObserverRegistry::kCapacity; i++) {
+      EXPECT_TRUE(registry.Add(static_cast<intptr_t>(i + 1), []() {}));
+    }
+    EXPECT_FALSE(registry.Add(100, []() {}));
+    // Replacing an observer needs no room.
+    EXPECT_TRUE(registry.Add(1, []() {}));
+    EXPECT_TRUE(registry.Remove(1));
+    EXPECT_TRUE(registry.Add(100, []() {}));
+  });
+}
+
+}  // namespace testing
+}  // namespace fml
@@ -0,0 +1,260 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/trace_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fml {
+namespace tracing {
+
+std::atomic<bool> gTraceBufferEnabled{false};
+
+namespace {
+
+constexpr size_t kRecordsPerThread = 4096;
+constexpr uint32_t kDumpVersion = 1;
+
+struct Record {
+  int64_t start_nanos;
+  uint32_t duration_nanos;
+  uint16_t name;
+  uint16_t reserved;
+};
+
+static_assert(sizeof(Record) == 16, "Records are dumped as is.");
+
+// Written only by the thread that owns it. Buffers of exited threads are kept
+// for the dump and handed to new threads once recording restarts.
+//
+// Restarting the recording does not touch the buffers of other threads.
+// Instead it starts a new generation, and each owner empties its buffer the
+// next time it records an event. Buffers of an older generation are left out
+// of dumps.
+//
+// |writing| is set while the owner records an event, so that stopping the
+// recording can wait for events that are still being written.
+struct ThreadBuffer {
+  uint32_t thread = 0;
+  std::atomic<bool> owned{false};
+  std::atomic<bool> writing{false};
+  std::atomic<uint64_t> generation{0};
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> dropped{0};
+  Record records[kRecordsPerThread];
+};
+
+struct TraceBufferState {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint16_t> name_ids;
+  std::atomic<bool> overwrite{false};
+  std::atomic<uint64_t> generation{0};
+};
+
+TraceBufferState& GetState() {
+  static TraceBufferState* state = new TraceBufferState();
+  return *state;
+}
+
+class ThreadBufferOwner {
+ public:
+  ThreadBufferOwner() = default;
+
+  ~ThreadBufferOwner() {
+    if (buffer_ != nullptr) {
+      buffer_->owned.store(false, std::memory_order_release);
+    }
+  }
+
+  ThreadBuffer* Get() {
+    if (buffer_ == nullptr) {
+      buffer_ = Acquire();
+    }
+    return buffer_;
+  }
+
+ private:
+  ThreadBuffer* buffer_ = nullptr;
+
+  static ThreadBuffer* Acquire() {
+    auto& state = GetState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    const uint64_t generation =
+        state.generation.load(std::memory_order_acquire);
+    for (auto& buffer : state.buffers) {
+      // Only buffers of exited threads that are empty or left over from an
+      // earlier recording are reused, so that their events survive until the
+      // next dump.
+      if (!buffer->owned.load(std::memory_order_acquire) &&
+          (buffer->written.load(std::memory_order_relaxed) == 0 ||
+           buffer->generation.load(std::memory_order_relaxed) != generation)) {
+        buffer->owned.store(true, std::memory_order_relaxed);
+        return buffer.get();
+      }
+    }
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->thread = static_cast<uint32_t>(state.buffers.size());
+    buffer->owned.store(true, std::memory_order_relaxed);
+    state.buffers.push_back(std::move(buffer));
+    return state.buffers.back().get();
+  }
+
+  FML_DISALLOW_COPY_AND_ASSIGN(ThreadBufferOwner);
+};
+
+template <class T>
+void Append(std::vector<uint8_t>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Records an event into the buffer of the calling thread.
+void WriteRecord(ThreadBuffer* buffer,
+                 uint16_t name,
+                 fml::TimePoint start,
+                 fml::TimePoint end) {
+  auto& state = GetState();
+  const uint64_t generation = state.generation.load(std::memory_order_acquire);
+  if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+    // The recording was restarted since this thread last recorded an event.
+    // Emptied before the new generation is published so that dumps never see
+    // the old events as part of the new recording.
+    buffer->written.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    buffer->generation.store(generation, std::memory_order_release);
+  }
+
+  const uint64_t written = buffer->written.load(std::memory_order_relaxed);
+  if (written >= kRecordsPerThread &&
+      !state.overwrite.load(std::memory_order_relaxed)) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const int64_t duration = (end - start).ToNanoseconds();
+  Record& record = buffer->records[written % kRecordsPerThread];
+  record.start_nanos = start.ToEpochDelta().ToNanoseconds();
+  record.duration_nanos = static_cast<uint32_t>(std::min<int64_t>(
+      std::max<int64_t>(duration, 0), std::numeric_limits<uint32_t>::max()));
+  record.name = name;
+  record.reserved = 0;
+  buffer->written.store(written + 1, std::memory_order_release);
+}
+
+}  // namespace
+
+void TraceBufferStart(bool overwrite) {
+  auto& state = GetState();
+  state.overwrite.store(overwrite, std::memory_order_relaxed);
+  state.generation.fetch_add(1, std::memory_order_acq_rel);
+  gTraceBufferEnabled.store(true, std::memory_order_release);
+}
+
+void TraceBufferStop() {
+  // Pairs with the check in |TraceBufferAddComplete|: either a writer sees
+  // that recording stopped, or the wait below sees the writer.
+  gTraceBufferEnabled.store(false, std::memory_order_seq_cst);
+  auto& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (const auto& buffer : state.buffers) {
+    while (buffer->writing.load(std::memory_order_seq_cst)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+uint16_t TraceBufferInternName(const char* name) {
+  auto& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  auto found = state.name_ids.find(name);
+  if (found != state.name_ids.end()) {
+    return found->second;
+  }
+  if (state.names.size() > std::numeric_limits<uint16_t>::max()) {
+    return 0;
+  }
+  const auto id = static_cast<uint16_t>(state.names.size());
+  state.names.emplace_back(name);
+  state.name_ids.emplace(name, id);
+  return id;
+}
+
+void TraceBufferAddComplete(uint16_t name,
+                            fml::TimePoint start,
+                            fml::TimePoint end) {
+  if (!TraceBufferIsEnabled()) {
+    return;
+  }
+  thread_local ThreadBufferOwner owner;
+  ThreadBuffer* buffer = owner.Get();
+
+  buffer->writing.store(true, std::memory_order_seq_cst);
+  if (!gTraceBufferEnabled.load(std::memory_order_seq_cst)) {
+    buffer->writing.store(false, std::memory_order_release);
+    return;
+  }
+  WriteRecord(buffer, name, start, end);
+  buffer->writing.store(false, std::memory_order_release);
+}
+
+std::vector<uint8_t> TraceBufferSerialize() {
+  auto& state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+
+  std::vector<uint8_t> out;
+  out.insert(out.end(), {'F', 'L', 'T', 'B'});
+  Append(out, kDumpVersion);
+  Append(out, static_cast<uint32_t>(state.names.size()));
+  Append(out, static_cast<uint32_t>(state.buffers.size()));
+
+  for (size_t id = 0; id < state.names.size(); id++) {
+    const auto& name = state.names[id];
+    const auto length = static_cast<uint16_t>(
+        std::min<size_t>(name.size(), std::numeric_limits<uint16_t>::max()));
+    Append(out, static_cast<uint16_t>(id));
+    Append(out, length);
+    out.insert(out.end(), name.begin(), name.begin() + length);
+  }
+
+  const uint64_t generation = state.generation.load(std::memory_order_acquire);
+  for (const auto& buffer : state.buffers) {
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    if (buffer->generation.load(std::memory_order_acquire) == generation) {
+      written = buffer->written.load(std::memory_order_acquire);
+      dropped = buffer->dropped.load(std::memory_order_relaxed);
+    }
+    const uint64_t count = std::min<uint64_t>(written, kRecordsPerThread);
+    dropped += written - count;
+    Append(out, buffer->thread);
+    Append(out, static_cast<uint32_t>(count));
+    Append(out, dropped);
+    for (uint64_t index = written - count; index < written; index++) {
+      Append(out, buffer->records[index % kRecordsPerThread]);
+    }
+  }
+  return out;
+}
+
+bool TraceBufferWriteToFile(const std::string& path) {
+  const auto dump = TraceBufferSerialize();
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(dump.data()), dump.size());
+  return static_cast<bool>(file);
+}
+
+}  // namespace tracing
+}  // namespace fml
@@ -0,0 +1,107 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_TRACE_BUFFER_H_
+#define FLUTTER_FML_TRACE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "flutter/fml/macros.h"
+#include "flutter/fml/time/time_point.h"
+
+// A low overhead alternative to the timeline macros in trace_event.h for
+// production startup and endless tracing.
+//
+// Events are recorded into per-thread ring buffers without locks or string
+// formatting. Event names are interned once per call site. The buffers are
+// serialized into a compact binary dump that trace_buffer_to_json.py converts
+// into the Chrome trace event format for chrome://tracing and Perfetto.
+//
+// Dump format (host byte order):
+//   char     magic[4]      "FLTB"
+//   uint32_t version       1
+//   uint32_t name_count
+//   uint32_t thread_count
+//   name_count times:
+//     uint16_t id, uint16_t length, char name[length]
+//   thread_count times:
+//     uint32_t thread, uint32_t record_count, uint64_t dropped_count
+//     record_count times, oldest first:
+//       int64_t start_nanos, uint32_t duration_nanos, uint16_t name, uint16_t 0
+
+#define FML_TRACE_BUFFER_CONCAT_IMPL(a, b) a##b
+#define FML_TRACE_BUFFER_CONCAT(a, b) FML_TRACE_BUFFER_CONCAT_IMPL(a, b)
+
+#define FML_TRACE_BUFFER_SCOPE(name)                                       \
+  static const uint16_t FML_TRACE_BUFFER_CONCAT(__trace_buffer_name_,      \
+                                                __LINE__) =                \
+      ::fml::tracing::TraceBufferInternName(name);                         \
+  ::fml::tracing::ScopedTraceBufferEvent FML_TRACE_BUFFER_CONCAT(          \
+      __trace_buffer_event_, __LINE__)(                                    \
+      FML_TRACE_BUFFER_CONCAT(__trace_buffer_name_, __LINE__))
+
+namespace fml {
+namespace tracing {
+
+extern std::atomic<bool> gTraceBufferEnabled;
+
+// Starts recording, discarding the events of any previous recording. When
+// |overwrite| is set the oldest events of a thread are replaced once its buffer
+// is full, otherwise new events are dropped. May be called while other threads
+// are recording.
+void TraceBufferStart(bool overwrite);
+
+// Stops recording. Returns once no other thread is still writing an event, so
+// that the buffers can be serialized while those threads keep running.
+void TraceBufferStop();
+
+inline bool TraceBufferIsEnabled() {
+  return gTraceBufferEnabled.load(std::memory_order_relaxed);
+}
+
+// Returns a stable id for |name|. Takes a lock, so call sites intern their
+// names once (see |FML_TRACE_BUFFER_SCOPE|).
+uint16_t TraceBufferInternName(const char* name);
+
+void TraceBufferAddComplete(uint16_t name,
+                            fml::TimePoint start,
+                            fml::TimePoint end);
+
+// Serializes the recorded events. Should be called after |TraceBufferStop|,
+// otherwise events recorded concurrently may be missing or, when overwriting,
+// torn.
+std::vector<uint8_t> TraceBufferSerialize();
+
+bool TraceBufferWriteToFile(const std::string& path);
+
+class ScopedTraceBufferEvent {
+ public:
+  explicit ScopedTraceBufferEvent(uint16_t name)
+      : name_(name), enabled_(TraceBufferIsEnabled()) {
+    if (enabled_) {
+      start_ = fml::TimePoint::Now();
+    }
+  }
+
+  ~ScopedTraceBufferEvent() {
+    if (enabled_) {
+      TraceBufferAddComplete(name_, start_, fml::TimePoint::Now());
+    }
+  }
+
+ private:
+  const uint16_t name_;
+  const bool enabled_;
+  fml::TimePoint start_;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(ScopedTraceBufferEvent);
+};
+
+}  // namespace tracing
+}  // namespace fml
+
+#endif  // FLUTTER_FML_TRACE_BUFFER_H_
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Converts a binary trace buffer dump into the Chrome trace event format.
+
+The dump is written by fml::tracing::TraceBufferWriteToFile (see
+trace_buffer.h for the format). The output can be loaded into chrome://tracing
+or the Perfetto UI.
+
+Usage:
+  trace_buffer_to_json.py --input trace.bin --output trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b'FLTB'
+VERSION = 1
+RECORD = struct.Struct('=qIHH')
+
+
+class Reader(object):
+
+  def __init__(self, data):
+    self.data = data
+    self.offset = 0
+
+  def Read(self, fmt):
+    values = struct.unpack_from('=' + fmt, self.data, self.offset)
+    self.offset += struct.calcsize('=' + fmt)
+    return values
+
+  def ReadBytes(self, length):
+    value = self.data[self.offset:self.offset + length]
+    self.offset += length
+    return value
+
+
+def Convert(data):
+  reader = Reader(data)
+  if reader.ReadBytes(4) != MAGIC:
+    raise ValueError('Not a trace buffer dump.')
+  version, name_count, thread_count = reader.Read('III')
+  if version != VERSION:
+    raise ValueError('Unsupported trace buffer version %d.' % version)
+
+  names = {}
+  for _ in range(name_count):
+    name_id, length = reader.Read('HH')
+    names[name_id] = reader.ReadBytes(length).decode('utf-8', 'replace')
+
+  events = []
+  dropped_total = 0
+  for _ in range(thread_count):
+    thread, record_count, dropped = reader.Read('IIQ')
+    dropped_total += dropped
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': thread,
+                   'args': {'name': 'Thread %d' % thread}})
+    for _ in range(record_count):
+      start, duration, name_id, _ = RECORD.unpack_from(reader.data,
+                                                       reader.offset)
+      reader.offset += RECORD.size
+      events.append({'name': names.get(name_id, str(name_id)), 'ph': 'X',
+                     'pid': 0, 'tid': thread, 'ts': start / 1000.0,
+                     'dur': duration / 1000.0})
+
+  return {'traceEvents': events, 'displayTimeUnit': 'ns',
+          'otherData': {'dropped_events': dropped_total}}
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--input', required=True, help='The binary dump.')
+  parser.add_argument('--output', required=True,
+      help='Where to write the JSON trace.')
+  args = parser.parse_args()
+
+  with open(args.input, 'rb') as f:
+    trace = Convert(f.read())
+  with open(args.output, 'w') as f:
+    json.dump(trace, f)
+
+  print('Converted %d events, %d dropped.' % (len(trace['traceEvents']),
+      trace['otherData']['dropped_events']))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,218 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/trace_buffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fml {
+namespace tracing {
+namespace testing {
+
+struct DumpedThread {
+  uint32_t record_count = 0;
+  uint64_t dropped_count = 0;
+  std::vector<std::pair<std::string, int64_t>> events;
+};
+
+// Parses a dump, see the format in trace_buffer.h. Threads without events are
+// left out, as the buffers of earlier tests are still around.
+static std::vector<DumpedThread> ParseDump(const std::vector<uint8_t>& dump) {
+  size_t offset = 0;
+  auto read = [&dump, &offset](void* value, size_t size) {
+    EXPECT_LE(offset + size, dump.size());
+    ::memcpy(value, dump.data() + offset, size);
+    offset += size;
+  };
+  char magic[4];
+  uint32_t version = 0, name_count = 0, thread_count = 0;
+  read(magic, sizeof(magic));
+  read(&version, sizeof(version));
+  read(&name_count, sizeof(name_count));
+  read(&thread_count, sizeof(thread_count));
+  EXPECT_EQ(std::string(magic, 4), "FLTB");
+  EXPECT_EQ(version, 1u);
+
+  std::map<uint16_t, std::string> names;
+  for (uint32_t i = 0; i < name_count; i++) {
+    uint16_t id = 0, length = 0;
+    read(&id, sizeof(id));
+    read(&length, sizeof(length));
+    std::string name(length, '\0');
+    read(&name[0], length);
+    names[id] = name;
+  }
+
+  std::vector<DumpedThread> threads;
+  for (uint32_t i = 0; i < thread_count; i++) {
+    DumpedThread thread;
+    uint32_t id = 0;
+    read(&id, sizeof(id));
+    read(&thread.record_count, sizeof(thread.record_count));
+    read(&thread.dropped_count, sizeof(thread.dropped_count));
+    for (uint32_t j = 0; j < thread.record_count; j++) {
+      int64_t start = 0;
+      uint32_t duration = 0;
+      uint16_t name = 0, reserved = 0;
+      read(&start, sizeof(start));
+      read(&duration, sizeof(duration));
+      read(&name, sizeof(name));
+      read(&reserved, sizeof(reserved));
+      thread.events.emplace_back(names[name], start);
+    }
+    if (thread.record_count > 0 || thread.dropped_count > 0) {
+      threads.push_back(std::move(thread));
+    }
+  }
+  EXPECT_EQ(offset, dump.size());
+  return threads;
+}
+
+static void AddEvents(uint16_t name, int count) {
+  for (int i = 0; i < count; i++) {
+    auto start =
+        fml::TimePoint::FromEpochDelta(fml::TimeDelta::FromNanoseconds(i));
+    TraceBufferAddComplete(name, start,
+                           start + fml::TimeDelta::FromNanoseconds(10));
+  }
+}
+
+TEST(TraceBufferTest, RecordsEventsOfEveryThread) {
+  TraceBufferStart(false);
+  {
+    FML_TRACE_BUFFER_SCOPE("TraceBufferTest.Main");
+  }
+  std::thread thread([]() { AddEvents(TraceBufferInternName("Worker"), 3); });
+  thread.join();
+  TraceBufferStop();
+  // Not recorded while stopped.
+  AddEvents(TraceBufferInternName("Stopped"), 1);
+
+  auto threads = ParseDump(TraceBufferSerialize());
+  ASSERT_EQ(threads.size(), 2u);
+  EXPECT_EQ(threads[0].events.size() + threads[1].events.size(), 4u);
+  for (const auto& thread : threads) {
+    EXPECT_EQ(thread.dropped_count, 0u);
+    for (const auto& event : thread.events) {
+      EXPECT_NE(event.first, "Stopped");
+    }
+  }
+}
+
+TEST(TraceBufferTest, DropsOrOverwritesOnceFull) {
+  const uint16_t name = TraceBufferInternName("Full");
+
+  TraceBufferStart(false);
+  AddEvents(name, 5000);
+  TraceBufferStop();
+  auto threads = ParseDump(TraceBufferSerialize());
+  ASSERT_EQ(threads.size(), 1u);
+  EXPECT_EQ(threads[0].record_count, 4096u);
+  EXPECT_EQ(threads[0].dropped_count, 5000u - 4096u);
+  EXPECT_EQ(threads[0].events.front().second, 0);
+
+  TraceBufferStart(true);
+  AddEvents(name, 5000);
+  TraceBufferStop();
+  threads = ParseDump(TraceBufferSerialize());
+  ASSERT_EQ(threads.size(), 1u);
+  EXPECT_EQ(threads[0].record_count, 4096u);
+  EXPECT_EQ(threads[0].dropped_count, 5000u - 4096u);
+  // The oldest events were overwritten.
+  EXPECT_EQ(threads[0].events.front().second, 5000 - 4096);
+  EXPECT_EQ(threads[0].events.back().second, 4999);
+}
+
+TEST(TraceBufferTest, RestartDiscardsEventsOfThreadsStillRecording) {
+  const uint16_t before = TraceBufferInternName("BeforeRestart");
+  const uint16_t after = TraceBufferInternName("AfterRestart");
+  std::mutex mutex;
+  std::condition_variable cv;
+  int step = 0;
+  auto wait_for = [&](int value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return step >= value; });
+  };
+  auto advance_to = [&](int value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    step = value;
+    cv.notify_all();
+  };
+
+  TraceBufferStart(false);
+  std::thread thread([&]() {
+    AddEvents(before, 10);
+    advance_to(1);
+    wait_for(2);
+    AddEvents(after, 2);
+    advance_to(3);
+    // Keeps recording while the main thread restarts again.
+    wait_for(4);
+    AddEvents(after, 1000);
+  });
+
+  wait_for(1);
+  // The worker keeps its buffer, which must not be touched from here.
+  TraceBufferStart(false);
+  auto threads = ParseDump(TraceBufferSerialize());
+  EXPECT_TRUE(threads.empty());
+
+  advance_to(2);
+  wait_for(3);
+  threads = ParseDump(TraceBufferSerialize());
+  ASSERT_EQ(threads.size(), 1u);
+  ASSERT_EQ(threads[0].events.size(), 2u);
+  EXPECT_EQ(threads[0].events[0].first, "AfterRestart");
+
+  advance_to(4);
+  TraceBufferStart(false);
+  thread.join();
+  TraceBufferStop();
+}
+
+TEST(TraceBufferTest, StopWaitsForEventsBeingWritten) {
+  const uint16_t name = TraceBufferInternName("Concurrent");
+  std::atomic<bool> done{false};
+  std::vector<std::thread> writers;
+  TraceBufferStart(true);
+  for (int i = 0; i < 4; i++) {
+    writers.emplace_back([&]() {
+      while (!done.load()) {
+        AddEvents(name, 100);
+      }
+    });
+  }
+
+  // The writers keep overwriting their buffers, which must not change while
+  // they are serialized.
+  for (int i = 0; i < 20; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TraceBufferStop();
+    for (const auto& thread : ParseDump(TraceBufferSerialize())) {
+      for (const auto& event : thread.events) {
+        EXPECT_EQ(event.first, "Concurrent");
+        EXPECT_LT(event.second, 100);
+      }
+    }
+    TraceBufferStart(true);
+  }
+
+  done.store(true);
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  TraceBufferStop();
+}
+
+}  // namespace testing
+}  // namespace tracing
+}  // namespace fml
@@ -0,0 +1,47 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/versioned_mapping.h"
+
+namespace fml {
+
+VersionedMapping::VersionedMapping(std::shared_ptr<const Mapping> mapping,
+                                   uint64_t version)
+    : current_(std::move(mapping)), version_(version) {}
+
+VersionedMapping::~VersionedMapping() = default;
+
+bool VersionedMapping::Update(std::shared_ptr<const Mapping> mapping,
+                              uint64_t version) {
+  if (!mapping) {
+    return false;
+  }
+
+  std::shared_ptr<const Mapping> superseded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (version <= version_) {
+      return false;
+    }
+    superseded = std::move(current_);
+    current_ = std::move(mapping);
+    version_ = version;
+  }
+  // Unmapping the superseded version happens outside of the lock, or not at
+  // all if a reader still holds it.
+  superseded.reset();
+  return true;
+}
+
+std::shared_ptr<const Mapping> VersionedMapping::Acquire() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_;
+}
+
+uint64_t VersionedMapping::GetVersion() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return version_;
+}
+
+}  // namespace fml
@@ -0,0 +1,50 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FLUTTER_FML_VERSIONED_MAPPING_H_
+#define FLUTTER_FML_VERSIONED_MAPPING_H_
+
+#include <memory>
+#include <mutex>
+
+#include "flutter/fml/macros.h"
+#include "flutter/fml/mapping.h"
+
+namespace fml {
+
+// Holds the current version of a mapping whose contents are replaced by newer
+// versions over time. This allows large, file backed payloads to be updated
+// without tearing down the objects that hold on to older versions.
+//
+// Readers obtain a version with |Acquire| and read both the data and the size
+// from it. A version is released once it has been replaced and no reader holds
+// on to it anymore. Readers never see a newer version unless they acquire it
+// again.
+class VersionedMapping {
+ public:
+  VersionedMapping(std::shared_ptr<const Mapping> mapping, uint64_t version);
+
+  ~VersionedMapping();
+
+  // Replaces the contents of the mapping. Updates to a version that is not
+  // newer than the current one are ignored. Returns true if the contents were
+  // replaced.
+  bool Update(std::shared_ptr<const Mapping> mapping, uint64_t version);
+
+  // Returns the current version of the contents.
+  std::shared_ptr<const Mapping> Acquire() const;
+
+  uint64_t GetVersion() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Mapping> current_;
+  uint64_t version_;
+
+  FML_DISALLOW_COPY_AND_ASSIGN(VersionedMapping);
+};
+
+}  // namespace fml
+
+#endif  // FLUTTER_FML_VERSIONED_MAPPING_H_
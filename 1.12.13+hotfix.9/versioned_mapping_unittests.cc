@@ -0,0 +1,101 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "flutter/fml/versioned_mapping.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fml {
+namespace testing {
+
+static std::shared_ptr<const Mapping> MakeMapping(size_t size, uint8_t value) {
+  return std::make_shared<DataMapping>(std::vector<uint8_t>(size, value));
+}
+
+TEST(VersionedMappingTest, IgnoresOlderVersions) {
+  VersionedMapping mapping(MakeMapping(4, 1), 2);
+  ASSERT_FALSE(mapping.Update(MakeMapping(8, 2), 2));
+  ASSERT_FALSE(mapping.Update(MakeMapping(8, 2), 1));
+  ASSERT_FALSE(mapping.Update(nullptr, 3));
+  ASSERT_EQ(mapping.GetVersion(), 2u);
+  ASSERT_EQ(mapping.Acquire()->GetSize(), 4u);
+
+  ASSERT_TRUE(mapping.Update(MakeMapping(8, 2), 3));
+  ASSERT_EQ(mapping.GetVersion(), 3u);
+  ASSERT_EQ(mapping.Acquire()->GetSize(), 8u);
+}
+
+TEST(VersionedMappingTest, ReleasesTheInitialVersionOnceReplaced) {
+  std::weak_ptr<const Mapping> initial;
+  auto version = MakeMapping(4, 1);
+  initial = version;
+  VersionedMapping mapping(std::move(version), 1);
+  ASSERT_FALSE(initial.expired());
+  ASSERT_TRUE(mapping.Update(MakeMapping(16, 2), 2));
+  ASSERT_TRUE(initial.expired());
+}
+
+TEST(VersionedMappingTest, ReleasesSupersededVersionsOnceUnused) {
+  std::weak_ptr<const Mapping> first;
+  std::weak_ptr<const Mapping> second;
+  VersionedMapping mapping(MakeMapping(4, 1), 1);
+  {
+    auto version = MakeMapping(4, 2);
+    second = version;
+    ASSERT_TRUE(mapping.Update(std::move(version), 2));
+  }
+
+  auto reader = mapping.Acquire();
+  ASSERT_TRUE(mapping.Update(MakeMapping(4, 3), 3));
+  // Still held by the reader.
+  ASSERT_FALSE(second.expired());
+  ASSERT_EQ(reader->GetMapping()[0], 2);
+  reader.reset();
+  ASSERT_TRUE(second.expired());
+
+  first = mapping.Acquire();
+  ASSERT_TRUE(mapping.Update(MakeMapping(4, 4), 4));
+  ASSERT_TRUE(first.expired());
+}
+
+TEST(VersionedMappingTest, ReadersSeeConsistentVersionsDuringUpdates) {
+  // Each version is filled with its own number and sized after it, so a torn
+  // read would pair the data of one version with the size of another.
+  VersionedMapping mapping(MakeMapping(1, 1), 1);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> torn_reads(0);
+
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      while (!done.load()) {
+        auto version = mapping.Acquire();
+        const size_t size = version->GetSize();
+        const uint8_t* data = version->GetMapping();
+        if (data[size - 1] != static_cast<uint8_t>(size)) {
+          torn_reads++;
+        }
+      }
+    });
+  }
+
+  for (uint64_t version = 2; version < 2000; version++) {
+    const size_t size = version % 255 + 1;
+    ASSERT_TRUE(mapping.Update(
+        MakeMapping(size, static_cast<uint8_t>(size)), version));
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(torn_reads.load(), 0u);
+}
+
+}  // namespace testing
+}  // namespace fml
@@ -47,6 +47,20 @@
 + (void)sendEvent:(NSString *)eventName
         arguments:(NSDictionary *)arguments;
 
+/**
+ * 页面生命周期事件合并发送。开启后同一个RunLoop周期内的页面事件会合并成一个__batch__调用发送给Dart层，
+ * 需要Dart层支持__batch__，Dart层返回FlutterMethodNotImplemented时会自动回退为逐个发送。
+ * 首个__batch__调用得到回复之前，其它消息会暂缓发送，以保证回退后消息的顺序不变；超过2秒未回复或引擎被替换时
+ * 不再暂缓。didInitPageContainer和willDeallocPageContainer对application的回调在对应事件发送给Dart之后执行。
+ * 默认关闭。
+ */
+@property (class, nonatomic, assign) BOOL batchesPageEvents;
+
+/**
+ * 方法通道被新引擎的通道替换时调用。旧引擎不会再回复__batch__调用，暂缓的消息会立即发送到新通道。
+ */
++ (void)methodChannelDidChange;
+
 + (FLBVoidCallback)addEventListener:(FLBEventListener)listner
                             forName:(NSString *)name;
 
@@ -26,6 +26,10 @@
 
 @implementation BoostMessageChannel
 
+//Listener lists are copy-on-write: the dictionary maps event names to immutable
+//arrays that are replaced, never mutated, under the lock. Dispatch only takes
+//the lock to grab the current array, so listeners may add or remove listeners
+//(including themselves) while an event is being delivered.
 + (NSMutableDictionary *)lists{
     static NSMutableDictionary *_list = nil;
     static dispatch_once_t onceToken;
@@ -34,6 +38,14 @@
     });
     return _list;
 }
+
++ (NSArray *)listenersForName:(NSString *)name
+{
+    NSMutableDictionary *lists = [self lists];
+    @synchronized (lists) {
+        return lists[name];
+    }
+}
  
  + (FlutterMethodChannel *)methodChannel
  {
@@ -44,12 +56,13 @@
         arguments:(NSDictionary *)arguments
 {
     if(!eventName) return;
+    [self flushPendingCalls];
     NSMutableDictionary *msg = [NSMutableDictionary new];
     msg[@"name"] = eventName;
     msg[@"arguments"] = arguments;
-    [self.methodChannel invokeMethod:@"__event__"
-                 arguments:msg
-                    result:^(id r){}];
+    [self invokeMethod:@"__event__"
+             arguments:msg
+                result:^(id r){}];
 }
 
 + (FLBVoidCallback)addEventListener:(FLBEventListener)listner
@@ -57,14 +70,30 @@
 {
     if(!name || !listner) return ^{};
     
-    NSMutableArray *list = [self lists][name];
-    if(!list){
-        list = [NSMutableArray new];
-        [self lists][name] = list;
+    //Each registration gets its own copy so removing it never affects another
+    //registration of the same block.
+    FLBEventListener entry = [^(NSString *eventName, NSDictionary *arguments){
+        listner(eventName, arguments);
+    } copy];
+    name = [name copy];
+    NSMutableDictionary *lists = [self lists];
+    @synchronized (lists) {
+        NSArray *list = lists[name] ?: @[];
+        lists[name] = [list arrayByAddingObject:entry];
     }
-    [list addObject:listner];
     return ^{
-        [list removeObject:listner];
+        @synchronized (lists) {
+            NSArray *list = lists[name];
+            NSUInteger index = [list indexOfObjectIdenticalTo:entry];
+            if(index == NSNotFound) return;
+            NSMutableArray *updated = [list mutableCopy];
+            [updated removeObjectAtIndex:index];
+            if(updated.count){
+                lists[name] = [updated copy];
+            }else{
+                [lists removeObjectForKey:name];
+            }
+        }
     };
 }
 
@@ -74,11 +103,8 @@
         NSString *name = call.arguments[@"name"];
         NSDictionary *arguments = call.arguments[@"arguments"];
         if(name){
-            NSMutableArray *list = [self lists][name];
-            if(list){
-                for(FLBEventListener l in list){
-                    l(name,arguments);
-                }
+            for(FLBEventListener l in [self listenersForName:name]){
+                l(name,arguments);
             }
         }
     }
@@ -86,127 +112,280 @@
 
  + (void)onNativePageResult:(void (^)(NSNumber *))result uniqueId:(NSString *)uniqueId key:(NSString *)key resultData:(NSDictionary *)resultData params:(NSDictionary *)params
  {
+     [self flushPendingCalls];
      NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
      if(uniqueId) tmp[@"uniqueId"] = uniqueId;
      if(key) tmp[@"key"] = key;
      if(resultData) tmp[@"resultData"] = resultData;
      if(params) tmp[@"params"] = params;
-     [self.methodChannel invokeMethod:@"onNativePageResult" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
- }
- 
- + (void)didShowPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"didShowPageContainer" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
- }
- 
- + (void)willShowPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"willShowPageContainer" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
- }
- 
- + (void)willDisappearPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"willDisappearPageContainer" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
- }
- 
- + (void)didDisappearPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"didDisappearPageContainer" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
- }
- 
- + (void)didInitPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"didInitPageContainer" arguments:tmp result:^(id tTesult) {
-         if (result) {
-             result(tTesult);
-         }
-     }];
-     
-     [FlutterBoostPlugin.sharedInstance.application didInitPageContainer:pageName
-                                                                  params:params
-                                                                uniqueId:uniqueId];
- }
- 
- + (void)willDeallocPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
- {
-     if ([pageName isEqualToString:kIgnoreMessageWithName]) {
-         return;
-     }
-     
-     NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
-     if(pageName) tmp[@"pageName"] = pageName;
-     if(params) tmp[@"params"] = params;
-     if(uniqueId) tmp[@"uniqueId"] = uniqueId;
-     [self.methodChannel invokeMethod:@"willDeallocPageContainer" arguments:tmp result:^(id tTesult) {
+     [self invokeMethod:@"onNativePageResult" arguments:tmp result:^(id tTesult) {
          if (result) {
              result(tTesult);
          }
      }];
-     
-     [FlutterBoostPlugin.sharedInstance.application willDeallocPageContainer:pageName
-                                                                      params:params
-                                                                    uniqueId:uniqueId];
  }
  
- 
- @end
++ (void)didShowPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    [self invokePageMethod:@"didShowPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+}
+
++ (void)willShowPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    [self invokePageMethod:@"willShowPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+}
+
++ (void)willDisappearPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    [self invokePageMethod:@"willDisappearPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+}
+
++ (void)didDisappearPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    [self invokePageMethod:@"didDisappearPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+}
+
++ (void)didInitPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    if ([pageName isEqualToString:kIgnoreMessageWithName]) {
+        return;
+    }
+
+    [self invokePageMethod:@"didInitPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+
+    //The application is told after Dart, also when the event is still waiting to be batched.
+    [self performAfterPendingCalls:^{
+        [FlutterBoostPlugin.sharedInstance.application didInitPageContainer:pageName
+                                                                     params:params
+                                                                   uniqueId:uniqueId];
+    }];
+}
+
++ (void)willDeallocPageContainer:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    if ([pageName isEqualToString:kIgnoreMessageWithName]) {
+        return;
+    }
+
+    [self invokePageMethod:@"willDeallocPageContainer" result:result pageName:pageName params:params uniqueId:uniqueId];
+
+    //The application is told after Dart, also when the event is still waiting to be batched.
+    [self performAfterPendingCalls:^{
+        [FlutterBoostPlugin.sharedInstance.application willDeallocPageContainer:pageName
+                                                                         params:params
+                                                                       uniqueId:uniqueId];
+    }];
+}
+
+#pragma mark - batching
+
+static BOOL sBatchesPageEvents = NO;
+//Whether the Dart side has answered a __batch__ call yet, and whether it understood it.
+static BOOL sBatchSupportKnown = NO;
+static BOOL sDartHandlesBatches = NO;
+//While the first __batch__ call is unanswered every other call is held back, so that a
+//fallback to single calls still reaches Dart in the order the calls were made. The calls are
+//no longer held once the answer takes longer than kBatchSupportTimeout, or the channel is
+//replaced by the one of another engine, as the answer may then never come.
+static BOOL sAwaitingBatchSupport = NO;
+//Identifies the __batch__ call being waited for, so that a late answer releases nothing.
+static NSUInteger sBatchSupportRequest = 0;
+static const NSTimeInterval kBatchSupportTimeout = 2;
+
++ (BOOL)batchesPageEvents
+{
+    return sBatchesPageEvents;
+}
+
++ (void)setBatchesPageEvents:(BOOL)batchesPageEvents
+{
+    if(!batchesPageEvents) [self flushPendingCalls];
+    sBatchesPageEvents = batchesPageEvents;
+}
+
++ (NSMutableArray *)pendingCalls{
+    static NSMutableArray *_pendingCalls = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _pendingCalls = [NSMutableArray new];
+    });
+    return _pendingCalls;
+}
+
++ (NSMutableArray *)pendingResults{
+    static NSMutableArray *_pendingResults = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _pendingResults = [NSMutableArray new];
+    });
+    return _pendingResults;
+}
+
++ (NSMutableArray *)pendingCompletions{
+    static NSMutableArray *_pendingCompletions = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _pendingCompletions = [NSMutableArray new];
+    });
+    return _pendingCompletions;
+}
+
++ (NSMutableArray *)heldSends{
+    static NSMutableArray *_heldSends = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _heldSends = [NSMutableArray new];
+    });
+    return _heldSends;
+}
+
++ (void)performSend:(dispatch_block_t)send
+{
+    if(sAwaitingBatchSupport){
+        [[self heldSends] addObject:[send copy]];
+        return;
+    }
+    send();
+}
+
+//Runs block once the calls made so far have been handed to the channel.
++ (void)performAfterPendingCalls:(dispatch_block_t)block
+{
+    if([self pendingCalls].count){
+        [[self pendingCompletions] addObject:[block copy]];
+        return;
+    }
+    [self performSend:block];
+}
+
++ (void)releaseHeldSends
+{
+    sAwaitingBatchSupport = NO;
+    NSArray *sends = [[self heldSends] copy];
+    [[self heldSends] removeAllObjects];
+    for(dispatch_block_t send in sends){
+        [self performSend:send];
+    }
+}
+
++ (void)invokeMethod:(NSString *)method arguments:(id)arguments result:(FlutterResult)result
+{
+    [self performSend:^{
+        [self.methodChannel invokeMethod:method arguments:arguments result:result];
+    }];
+}
+
++ (void)invokePageMethod:(NSString *)method result:(void (^)(NSNumber *))result pageName:(NSString *)pageName params:(NSDictionary *)params uniqueId:(NSString *)uniqueId
+{
+    if ([pageName isEqualToString:kIgnoreMessageWithName]) {
+        return;
+    }
+
+    NSMutableDictionary *tmp = [NSMutableDictionary dictionary];
+    if(pageName) tmp[@"pageName"] = pageName;
+    if(params) tmp[@"params"] = params;
+    if(uniqueId) tmp[@"uniqueId"] = uniqueId;
+
+    if(!sBatchesPageEvents){
+        [self invokeMethod:method arguments:tmp result:^(id tTesult) {
+            if (result) {
+                result(tTesult);
+            }
+        }];
+        return;
+    }
+
+    //A navigation triggers several page events within the same run loop turn.
+    //They are sent to Dart as a single __batch__ call at the end of the turn.
+    if([self pendingCalls].count == 0){
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self flushPendingCalls];
+        });
+    }
+    [[self pendingCalls] addObject:@{@"method":method, @"arguments":tmp}];
+    [[self pendingResults] addObject:result ? [result copy] : NSNull.null];
+}
+
++ (void)flushPendingCalls
+{
+    if([self pendingCalls].count == 0) return;
+
+    NSArray *calls = [[self pendingCalls] copy];
+    NSArray *results = [[self pendingResults] copy];
+    NSArray *completions = [[self pendingCompletions] copy];
+    [[self pendingCalls] removeAllObjects];
+    [[self pendingResults] removeAllObjects];
+    [[self pendingCompletions] removeAllObjects];
+
+    [self performSend:^{
+        [self sendBatch:calls results:results];
+        for(dispatch_block_t completion in completions){
+            completion();
+        }
+    }];
+}
+
++ (void)sendCalls:(NSArray *)calls results:(NSArray *)results
+{
+    [calls enumerateObjectsUsingBlock:^(NSDictionary *call, NSUInteger idx, BOOL *stop) {
+        id result = results[idx];
+        [self.methodChannel invokeMethod:call[@"method"] arguments:call[@"arguments"] result:^(id tTesult) {
+            if (result != NSNull.null) {
+                ((void (^)(NSNumber *))result)(tTesult);
+            }
+        }];
+    }];
+}
+
++ (void)sendBatch:(NSArray *)calls results:(NSArray *)results
+{
+    if(sBatchSupportKnown && !sDartHandlesBatches){
+        [self sendCalls:calls results:results];
+        return;
+    }
+    NSUInteger request = 0;
+    if(!sBatchSupportKnown){
+        sAwaitingBatchSupport = YES;
+        request = ++sBatchSupportRequest;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kBatchSupportTimeout * NSEC_PER_SEC)),
+                       dispatch_get_main_queue(), ^{
+            if(sAwaitingBatchSupport && sBatchSupportRequest == request){
+                [self releaseHeldSends];
+            }
+        });
+    }
+
+    [self.methodChannel invokeMethod:@"__batch__" arguments:calls result:^(id batchResult) {
+        BOOL wasAwaiting = sAwaitingBatchSupport && request != 0 && sBatchSupportRequest == request;
+        sBatchSupportKnown = YES;
+        if(batchResult == FlutterMethodNotImplemented){
+            //The Dart side does not understand batches. Send the calls one by one instead.
+            sDartHandlesBatches = NO;
+            sBatchesPageEvents = NO;
+            [self sendCalls:calls results:results];
+        }else{
+            sDartHandlesBatches = YES;
+            //A FlutterError (or nil) answers the batch as a whole, like it would have
+            //answered each of the calls.
+            NSArray *batchResults = [batchResult isKindOfClass:NSArray.class] ? batchResult : nil;
+            [results enumerateObjectsUsingBlock:^(id result, NSUInteger idx, BOOL *stop) {
+                if(result != NSNull.null){
+                    id r = batchResults ? (idx < batchResults.count ? batchResults[idx] : nil) : batchResult;
+                    ((void (^)(NSNumber *))result)([r isKindOfClass:NSNull.class] ? nil : r);
+                }
+            }];
+        }
+        if(wasAwaiting) [self releaseHeldSends];
+    }];
+}
+
++ (void)methodChannelDidChange
+{
+    if(!sAwaitingBatchSupport) return;
+    //The engine that was asked is gone, and with it the answer. The next batch asks the new engine.
+    sBatchSupportRequest++;
+    [self releaseHeldSends];
+}
+
+
+@end
@@ -29,6 +29,14 @@ typedef bool (^FLBCollectionFilter)(id value);
 
 @interface FLBCollectionHelper : NSObject
 
+/**
+ * 过滤嵌套容器中所有不满足filter的值。有值被过滤掉的容器会被重新创建，新建的容器都是可变的（NSMutableDictionary/NSMutableArray）；
+ * 没有值被过滤掉的容器（包括整个origin）会被直接复用而不会被复制，其可变性与origin中的一致。
+ *
+ * 返回值可能与origin共享部分容器，修改返回值会同时修改origin。调用方只能在origin不再被其他地方使用时修改返回值，
+ * 否则应先自行复制。FlutterBoostPlugin中传入的是codec为本次调用解码出的call.arguments（可变容器，且不会被再次使用），
+ * 因此传给FLBPlatform的参数与之前一样可以安全修改。
+ */
 + (NSDictionary *)deepCopyNSDictionary:(NSDictionary *)origin filter:(FLBCollectionFilter)filter;
 + (NSArray *)deepCopyNSArray:(NSArray *)array filter:(FLBCollectionFilter)filter;
 
@@ -24,54 +24,136 @@
 
 #import "FLBCollectionHelper.h"
 
-@implementation FLBCollectionHelper
+//One container being copied. Children are visited in order; as long as every
+//child is kept unchanged no new container is built and the original is reused.
+@interface FLBCollectionCopyFrame : NSObject
+@property (nonatomic,strong) id origin;
+@property (nonatomic,strong) NSArray *keys;
+@property (nonatomic,strong) id parentKey;
+@property (nonatomic,assign) NSUInteger index;
+@property (nonatomic,strong) NSMutableArray *keptKeys;
+@property (nonatomic,strong) NSMutableArray *keptValues;
+@end
 
-+ (NSDictionary *)deepCopyNSDictionary:(NSDictionary *)origin filter:(FLBCollectionFilter)filter
+@implementation FLBCollectionCopyFrame
+
+- (instancetype)initWithOrigin:(id)origin parentKey:(id)parentKey
 {
-    if(origin.count < 1) return origin;
-    NSMutableDictionary *copyed = [NSMutableDictionary new];
-    [origin enumerateKeysAndObjectsUsingBlock:^(id  _Nonnull key, id  _Nonnull obj, BOOL * _Nonnull stop) {
-        
-        //Filter: Do not include invalid things
-        if(filter && !filter(obj)) return;
-        
-        if([obj isKindOfClass: NSDictionary.class]){
-            copyed[key] = [self deepCopyNSDictionary:obj filter:filter];
-        }else if([obj isKindOfClass:NSArray.class]){
-            copyed[key] = [self deepCopyNSArray:obj filter:filter];
-        }else{
-            copyed[key] = obj;
+    if (self = [super init]) {
+        _origin = origin;
+        _parentKey = parentKey;
+        if([origin isKindOfClass:NSDictionary.class]){
+            _keys = [origin allKeys];
         }
-    }];
+    }
     
-    return copyed;
+    return self;
 }
 
-+ (NSArray *)deepCopyNSArray:(NSArray *)origin filter:(FLBCollectionFilter)filter
+- (NSUInteger)count
 {
-    if(origin.count < 1) return origin;
-    NSMutableArray *copyed = [NSMutableArray new];
-    [origin enumerateObjectsUsingBlock:^(id  _Nonnull obj, NSUInteger idx, BOOL * _Nonnull stop) {
+    return [_origin count];
+}
 
-        //Filter: Do not include invalid things.
-        if(filter && !filter(obj)) return;
-        
-        id nObj = nil;
-        
-        if([obj isKindOfClass: NSDictionary.class]){
-            nObj = [self deepCopyNSDictionary:obj filter:filter];
-        }else if([obj isKindOfClass:NSArray.class]){
-            nObj = [self deepCopyNSArray:obj filter:filter];
-        }else{
-            nObj = obj;
-        }
+- (id)keyAtIndex:(NSUInteger)index
+{
+    return _keys ? _keys[index] : nil;
+}
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    return _keys ? _origin[_keys[index]] : _origin[index];
+}
+
+//Copies the children before the current one, which were all kept unchanged.
+- (void)materialize
+{
+    if(_keptValues) return;
+    NSUInteger current = _index - 1;
+    _keptValues = [NSMutableArray arrayWithCapacity:self.count];
+    if(_keys) _keptKeys = [NSMutableArray arrayWithCapacity:self.count];
+    for(NSUInteger i = 0; i < current; i++){
+        [_keptValues addObject:[self objectAtIndex:i]];
+        if(_keys) [_keptKeys addObject:_keys[i]];
+    }
+}
+
+- (void)drop
+{
+    [self materialize];
+}
+
+- (void)keep:(id)value forKey:(id)key changed:(BOOL)changed
+{
+    if(changed) [self materialize];
+    if(!_keptValues) return;
+    [_keptValues addObject:value];
+    if(_keys) [_keptKeys addObject:key];
+}
+
+//Containers that had to be rebuilt are mutable, like the copies this helper
+//always returned.
+- (id)result
+{
+    if(!_keptValues) return _origin;
+    if(_keys) return [NSMutableDictionary dictionaryWithObjects:_keptValues forKeys:_keptKeys];
+    return _keptValues;
+}
+
+@end
+
+@implementation FLBCollectionHelper
+
++ (BOOL)isCollection:(id)obj
+{
+    return [obj isKindOfClass:NSDictionary.class] || [obj isKindOfClass:NSArray.class];
+}
+
+//Filters every nested value in a single pass. Containers in which the filter
+//drops nothing are returned as they are instead of being copied, and nesting
+//is tracked on an explicit stack so deep payloads cannot overflow the call stack.
++ (id)copyCollection:(id)origin filter:(FLBCollectionFilter)filter
+{
+    if([origin count] < 1) return origin;
     
-        if (nObj) {
-            [copyed addObject:nObj];
-        }
-    }];
+    NSMutableArray<FLBCollectionCopyFrame *> *stack = [NSMutableArray new];
+    [stack addObject:[[FLBCollectionCopyFrame alloc] initWithOrigin:origin parentKey:nil]];
     
-    return copyed;
+    while(YES){
+        FLBCollectionCopyFrame *frame = stack.lastObject;
+        
+        if(frame.index < frame.count){
+            NSUInteger index = frame.index++;
+            id key = [frame keyAtIndex:index];
+            id obj = [frame objectAtIndex:index];
+            
+            //Filter: Do not include invalid things
+            if(filter && !filter(obj)){
+                [frame drop];
+            }else if([self isCollection:obj] && [obj count] > 0){
+                [stack addObject:[[FLBCollectionCopyFrame alloc] initWithOrigin:obj parentKey:key]];
+            }else{
+                [frame keep:obj forKey:key changed:NO];
+            }
+            continue;
+        }
+        
+        [stack removeLastObject];
+        id result = frame.result;
+        FLBCollectionCopyFrame *parent = stack.lastObject;
+        if(!parent) return result;
+        [parent keep:result forKey:frame.parentKey changed:result != frame.origin];
+    }
+}
+
++ (NSDictionary *)deepCopyNSDictionary:(NSDictionary *)origin filter:(FLBCollectionFilter)filter
+{
+    return [self copyCollection:origin filter:filter];
+}
+
++ (NSArray *)deepCopyNSArray:(NSArray *)origin filter:(FLBCollectionFilter)filter
+{
+    return [self copyCollection:origin filter:filter];
 }
 
 @end
@@ -24,9 +24,22 @@
 
 #import "FLBFlutterContainerManager.h"
 
+//A node of the page stack. Nodes are indexed by uid in existedID, so looking
+//up, pushing and unlinking a container are all O(1).
+@interface FLBContainerStackNode : NSObject
+@property (nonatomic,copy) NSString *uid;
+@property (nonatomic,copy) NSString *name;
+@property (nonatomic,weak) FLBContainerStackNode *prev;
+@property (nonatomic,strong) FLBContainerStackNode *next;
+@end
+
+@implementation FLBContainerStackNode
+@end
+
 @interface FLBFlutterContainerManager()
-@property (nonatomic,strong) NSMutableArray *idStk;
-@property (nonatomic,strong) NSMutableDictionary *existedID;
+@property (nonatomic,strong) FLBContainerStackNode *bottom;
+@property (nonatomic,weak) FLBContainerStackNode *top;
+@property (nonatomic,strong) NSMutableDictionary<NSString *, FLBContainerStackNode *> *existedID;
 @end
 
 @implementation FLBFlutterContainerManager
@@ -34,7 +47,6 @@
 - (instancetype)init
 {
     if (self = [super init]) {
-        _idStk= [NSMutableArray new];
         _existedID = [NSMutableDictionary dictionary];
     }
     
@@ -53,10 +65,21 @@
 - (void)addUnique:(id<FLBFlutterContainer>)vc
 {
     if (vc) {
-        if(!_existedID[vc.uniqueIDString]){
-            [_idStk addObject:vc.uniqueIDString];
+        NSString *uid = vc.uniqueIDString;
+        FLBContainerStackNode *node = _existedID[uid];
+        if(!node){
+            node = [FLBContainerStackNode new];
+            node.uid = uid;
+            node.prev = _top;
+            if(_top){
+                _top.next = node;
+            }else{
+                _bottom = node;
+            }
+            _top = node;
+            _existedID[uid] = node;
         }
-        _existedID[vc.uniqueIDString] = vc.name;
+        node.name = vc.name;
     }
 #if DEBUG
     [self dump:@"ADD"];
@@ -66,8 +89,23 @@
 - (void)remove:(id<FLBFlutterContainer>)vc
 {
     if (vc) {
-        [_existedID removeObjectForKey:vc.uniqueIDString];
-        [_idStk removeObject:vc.uniqueIDString];
+        FLBContainerStackNode *node = _existedID[vc.uniqueIDString];
+        if(node){
+            [_existedID removeObjectForKey:node.uid];
+            FLBContainerStackNode *prev = node.prev;
+            FLBContainerStackNode *next = node.next;
+            if(prev){
+                prev.next = next;
+            }else{
+                _bottom = next;
+            }
+            if(next){
+                next.prev = prev;
+            }else{
+                _top = prev;
+            }
+            node.next = nil;
+        }
     }
 #if DEBUG
     [self dump:@"REMOVE"];
@@ -76,14 +114,26 @@
 
 - (NSString *)peak
 {
-    return _idStk.lastObject;
+    return _top.uid;
+}
+
+- (void)dealloc
+{
+    //Unlink iteratively so releasing a deep stack does not recurse once per node.
+    FLBContainerStackNode *node = _bottom;
+    _bottom = nil;
+    while(node){
+        FLBContainerStackNode *next = node.next;
+        node.next = nil;
+        node = next;
+    }
 }
 
 #if DEBUG
 - (void)dump:(NSString*)flag{
     NSMutableString *log = [[NSMutableString alloc]initWithFormat:@"[DEBUG]--%@--PageStack uid/name", flag];
-    for(NSString *uid in _idStk){
-        [log appendFormat:@"-->%@/%@",uid, _existedID[uid]];
+    for(FLBContainerStackNode *node = _bottom; node; node = node.next){
+        [log appendFormat:@"-->%@/%@",node.uid, node.name];
     }
     NSLog(@"%@\n", log);
 }
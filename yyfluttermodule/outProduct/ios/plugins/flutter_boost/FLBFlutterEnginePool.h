@@ -0,0 +1,90 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2019 Alibaba Group
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <Flutter/Flutter.h>
+#import "FLBPlatform.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^FLBEngineRegistrant)(FlutterEngine *engine);
+
+/**
+ * 预热的FlutterEngine池，用于打开独立于混合栈之外的Flutter流程。
+ * 池中所有引擎共享同一个Dart VM和已解析的Dart快照，因此除第一个引擎外，新引擎只需要创建自己的isolate。
+ * 空闲引擎都是未使用过的新引擎，超出容量或收到内存警告时会被淘汰。
+ * 所有方法都需要在主线程调用。
+ */
+@interface FLBFlutterEnginePool : NSObject
+
+/**
+ * @param platform 提供Dart入口的平台对象，可以为空
+ * @param capacity 最多保留的空闲引擎个数
+ * @param registrant 每个新建引擎的插件注册回调。不要在这里注册FlutterBoostPlugin，它只能绑定到混合栈的引擎上
+ */
+- (instancetype)initWithPlatform:(id<FLBPlatform> _Nullable)platform
+                        capacity:(NSUInteger)capacity
+                      registrant:(FLBEngineRegistrant _Nullable)registrant;
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, assign) NSUInteger capacity;
+
+/**
+ * 创建引擎直到空闲引擎个数达到capacity。每个RunLoop周期只创建一个引擎，避免一次性占用主线程
+ */
+- (void)warmUp;
+
+/**
+ * 取出一个空闲引擎，没有空闲引擎时新建一个。池会在之后的RunLoop周期补足空闲引擎。调用方持有返回的引擎直到调用recycleEngine:
+ */
+- (FlutterEngine *)dequeueEngine;
+
+/**
+ * 归还不再使用的引擎。引擎需要先和FlutterViewController解除关联。
+ * 用过的引擎的Dart状态无法重置，因此不会被放回池中，而是直接销毁；池会在下一个RunLoop周期新建引擎补足到capacity
+ */
+- (void)recycleEngine:(FlutterEngine *)engine;
+
+/**
+ * 淘汰最早创建的空闲引擎，直到最多剩下count个。空闲引擎都未使用过，被取出的引擎不会被淘汰。收到内存警告时会以0调用
+ */
+- (void)evictIdleEnginesKeeping:(NSUInteger)count;
+
+/**
+ * 统计从dequeueEngine到vc第一帧渲染完成的耗时。会替换vc已有的FlutterViewDidRenderCallback
+ */
+- (void)measureFirstFrameOfViewController:(FlutterViewController *)vc;
+
+#pragma mark - Metrics
+@property (nonatomic, readonly) NSUInteger idleCount;
+@property (nonatomic, readonly) NSUInteger hitCount;
+@property (nonatomic, readonly) NSUInteger missCount;
+@property (nonatomic, readonly) NSUInteger evictionCount;
+@property (nonatomic, readonly) double hitRate;
+@property (nonatomic, readonly) NSTimeInterval lastTimeToFirstFrame;
+@property (nonatomic, readonly) NSTimeInterval averageTimeToFirstFrame;
+
+@end
+
+NS_ASSUME_NONNULL_END
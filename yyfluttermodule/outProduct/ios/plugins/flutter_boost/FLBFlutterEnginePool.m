@@ -0,0 +1,188 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2019 Alibaba Group
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#import "FLBFlutterEnginePool.h"
+#import <QuartzCore/QuartzCore.h>
+
+@interface FLBFlutterEnginePool()
+@property (nonatomic,strong) id<FLBPlatform> platform;
+@property (nonatomic,copy) FLBEngineRegistrant registrant;
+//Dequeued from the end, evicted from the front.
+@property (nonatomic,strong) NSMutableArray<FlutterEngine *> *idleEngines;
+@property (nonatomic,strong) NSMapTable<FlutterEngine *, NSNumber *> *dequeueTimes;
+@property (nonatomic,assign) BOOL warmUpScheduled;
+@property (nonatomic,assign) NSUInteger measuredFrameCount;
+@property (nonatomic,assign) NSTimeInterval totalTimeToFirstFrame;
+@property (nonatomic,readwrite) NSUInteger hitCount;
+@property (nonatomic,readwrite) NSUInteger missCount;
+@property (nonatomic,readwrite) NSUInteger evictionCount;
+@property (nonatomic,readwrite) NSTimeInterval lastTimeToFirstFrame;
+@end
+
+@implementation FLBFlutterEnginePool
+
+- (instancetype)initWithPlatform:(id<FLBPlatform> _Nullable)platform
+                        capacity:(NSUInteger)capacity
+                      registrant:(FLBEngineRegistrant _Nullable)registrant
+{
+    if (self = [super init]) {
+        _platform = platform;
+        _capacity = capacity;
+        _registrant = [registrant copy];
+        _idleEngines = [NSMutableArray new];
+        _dequeueTimes = [NSMapTable weakToStrongObjectsMapTable];
+        [NSNotificationCenter.defaultCenter addObserver:self
+                                               selector:@selector(didReceiveMemoryWarning:)
+                                                   name:UIApplicationDidReceiveMemoryWarningNotification
+                                                 object:nil];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [NSNotificationCenter.defaultCenter removeObserver:self];
+    [self evictIdleEnginesKeeping:0];
+}
+
+- (FlutterEngine *)createEngine
+{
+    FlutterEngine *engine = [[FlutterEngine alloc] initWithName:@"io.flutter.pool" project:nil];
+    if(_platform &&
+       [_platform respondsToSelector: @selector(entryForDart)] &&
+       _platform.entryForDart){
+        [engine runWithEntrypoint:_platform.entryForDart];
+    }else{
+        [engine runWithEntrypoint:nil];
+    }
+    if(_registrant) _registrant(engine);
+    return engine;
+}
+
+- (void)setCapacity:(NSUInteger)capacity
+{
+    _capacity = capacity;
+    [self evictIdleEnginesKeeping:capacity];
+}
+
+//Starting an engine blocks the main thread, so only one is started per run loop
+//turn and the rest are left to the following turns.
+- (void)warmUp
+{
+    if(_idleEngines.count >= _capacity) return;
+    [_idleEngines insertObject:[self createEngine] atIndex:0];
+    [self scheduleWarmUp];
+}
+
+- (FlutterEngine *)dequeueEngine
+{
+    FlutterEngine *engine = _idleEngines.lastObject;
+    if(engine){
+        [_idleEngines removeLastObject];
+        _hitCount++;
+    }else{
+        engine = [self createEngine];
+        _missCount++;
+    }
+    [_dequeueTimes setObject:@(CACurrentMediaTime()) forKey:engine];
+    [self scheduleWarmUp];
+    return engine;
+}
+
+//The root isolate of a used engine still holds the state of the flow it ran,
+//and FlutterEngine has no way to start it over. Returning it to the pool would
+//leak that state into the next flow, so it is destroyed and a fresh engine is
+//warmed up in its place once the current run loop turn is over.
+- (void)recycleEngine:(FlutterEngine *)engine
+{
+    if(!engine || [_idleEngines indexOfObjectIdenticalTo:engine] != NSNotFound) return;
+    [_dequeueTimes removeObjectForKey:engine];
+    engine.viewController = nil;
+    [engine destroyContext];
+    [self scheduleWarmUp];
+}
+
+- (void)scheduleWarmUp
+{
+    if(_warmUpScheduled || _idleEngines.count >= _capacity) return;
+    _warmUpScheduled = YES;
+    __weak __typeof__(self) weakSelf = self;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        __strong __typeof__(weakSelf) self = weakSelf;
+        if(!self) return;
+        self.warmUpScheduled = NO;
+        [self warmUp];
+    });
+}
+
+- (void)evictIdleEnginesKeeping:(NSUInteger)count
+{
+    while(_idleEngines.count > count){
+        FlutterEngine *engine = _idleEngines.firstObject;
+        [_idleEngines removeObjectAtIndex:0];
+        [engine destroyContext];
+        _evictionCount++;
+    }
+}
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification
+{
+    [self evictIdleEnginesKeeping:0];
+}
+
+- (void)measureFirstFrameOfViewController:(FlutterViewController *)vc
+{
+    NSNumber *start = [_dequeueTimes objectForKey:vc.engine];
+    if(!start) return;
+    __weak __typeof__(self) weakSelf = self;
+    [vc setFlutterViewDidRenderCallback:^{
+        __strong __typeof__(weakSelf) self = weakSelf;
+        if(!self) return;
+        NSTimeInterval elapsed = CACurrentMediaTime() - start.doubleValue;
+        self.lastTimeToFirstFrame = elapsed;
+        self.totalTimeToFirstFrame += elapsed;
+        self.measuredFrameCount++;
+    }];
+}
+
+#pragma mark - Metrics
+
+- (NSUInteger)idleCount
+{
+    return _idleEngines.count;
+}
+
+- (double)hitRate
+{
+    NSUInteger total = _hitCount + _missCount;
+    return total ? (double)_hitCount / total : 0;
+}
+
+- (NSTimeInterval)averageTimeToFirstFrame
+{
+    return _measuredFrameCount ? _totalTimeToFirstFrame / _measuredFrameCount : 0;
+}
+
+@end
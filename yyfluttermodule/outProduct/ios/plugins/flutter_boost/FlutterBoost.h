@@ -28,6 +28,7 @@
 #import "FlutterBoostPlugin.h"
 #import "FLBFlutterAppDelegate.h"
 #import "FLBFlutterViewContainer.h"
+#import "FLBFlutterEnginePool.h"
 #import "FLBTypes.h"
 
 #endif /* FlutterBoost_h */
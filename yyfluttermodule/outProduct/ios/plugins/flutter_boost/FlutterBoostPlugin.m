@@ -40,7 +40,9 @@
                                      methodChannelWithName:@"flutter_boost"
                                      binaryMessenger:[registrar messenger]];
     FlutterBoostPlugin* instance = [self.class sharedInstance];
+    BOOL replacesChannel = instance.methodChannel != nil;
     instance.methodChannel = channel;
+    if(replacesChannel) [BoostMessageChannel methodChannelDidChange];
     [registrar addMethodCallDelegate:instance channel:channel];
 }
 